@@ -0,0 +1,138 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "Analysis/EscapeAnalysis.h"
+
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Operator.h>
+
+#include "IR/IR.h"
+#include "LanguageModel/LLVMInstrinsics.h"
+
+using namespace race;
+
+namespace {
+
+bool isHeapAlloc(const llvm::Function *func) {
+  auto const name = func->getName();
+  return name.equals("malloc") || name.equals("calloc") || name.equals("_Znwm") || name.equals("_Znam");
+}
+
+// Functions that are passed a pointer but cannot leak it
+bool isNoEscape(const llvm::Function *func) {
+  auto const name = func->getName();
+  return LLVMModel::isNoEffect(name) || name.startswith("llvm.memset") || name.equals("free") ||
+         name.equals("_ZdlPv") || name.equals("_ZdaPv");
+}
+
+// Strip casts and address computations to find the object ptr points into
+const llvm::Value *getBaseObject(const llvm::Value *ptr) {
+  while (true) {
+    if (auto gep = llvm::dyn_cast<llvm::GEPOperator>(ptr)) {
+      ptr = gep->getPointerOperand();
+    } else if (llvm::isa<llvm::BitCastOperator>(ptr) || llvm::isa<llvm::AddrSpaceCastOperator>(ptr)) {
+      ptr = llvm::cast<llvm::Operator>(ptr)->getOperand(0);
+    } else {
+      return ptr;
+    }
+  }
+}
+
+}  // namespace
+
+EscapeAnalysis::EscapeAnalysis(const llvm::Module &module) {
+  for (auto const &func : module) {
+    for (auto const &inst : llvm::instructions(func)) {
+      auto const isObject = [&inst]() {
+        if (llvm::isa<llvm::AllocaInst>(inst)) return true;
+        auto const call = llvm::dyn_cast<llvm::CallBase>(&inst);
+        if (!call) return false;
+        auto const callee = CallIR::resolveTargetFunction(call);
+        return callee && isHeapAlloc(callee);
+      };
+
+      if (isObject() && !mayEscape(&inst)) {
+        privateObjects.insert(&inst);
+      }
+    }
+  }
+}
+
+bool EscapeAnalysis::isThreadPrivateAccess(const llvm::Value *ptr) const {
+  return isThreadPrivate(getBaseObject(ptr));
+}
+
+bool EscapeAnalysis::mayEscape(const llvm::Argument *arg) {
+  // cppcheck-suppress stlIfFind
+  if (auto it = argEscapes.find(arg); it != argEscapes.end()) {
+    return it->second;
+  }
+
+  // Assume recursive calls let the argument escape while it is being computed
+  argEscapes[arg] = true;
+  auto const escapes = mayEscape(static_cast<const llvm::Value *>(arg));
+  argEscapes[arg] = escapes;
+  return escapes;
+}
+
+bool EscapeAnalysis::mayEscape(const llvm::Value *ptr) {
+  // Every value derived from ptr that still points into the same object
+  std::vector<const llvm::Value *> worklist{ptr};
+  std::set<const llvm::Value *> visited{ptr};
+
+  while (!worklist.empty()) {
+    auto const current = worklist.back();
+    worklist.pop_back();
+
+    for (auto const &use : current->uses()) {
+      auto const user = use.getUser();
+
+      if (llvm::isa<llvm::LoadInst>(user) || llvm::isa<llvm::ICmpInst>(user)) {
+        continue;
+      }
+
+      if (auto store = llvm::dyn_cast<llvm::StoreInst>(user)) {
+        // storing the pointer itself leaks it, storing to it does not
+        if (store->getValueOperand() == current) return true;
+        continue;
+      }
+
+      if (llvm::isa<llvm::GetElementPtrInst>(user) || llvm::isa<llvm::BitCastInst>(user) ||
+          llvm::isa<llvm::AddrSpaceCastInst>(user) || llvm::isa<llvm::PHINode>(user) ||
+          llvm::isa<llvm::SelectInst>(user)) {
+        if (visited.insert(user).second) {
+          worklist.push_back(user);
+        }
+        continue;
+      }
+
+      if (auto call = llvm::dyn_cast<llvm::CallBase>(user)) {
+        if (call->isCallee(&use)) continue;
+
+        auto const callee = CallIR::resolveTargetFunction(call);
+        if (!callee) return true;
+        if (isNoEscape(callee)) continue;
+        if (callee->isDeclaration() || callee->isVarArg() || !call->isArgOperand(&use)) return true;
+
+        // passed to a function defined in the module, escapes if the argument escapes the callee
+        auto const argNo = call->getArgOperandNo(&use);
+        if (argNo >= callee->arg_size() || mayEscape(callee->getArg(argNo))) return true;
+        continue;
+      }
+
+      // returned, converted to an integer, atomically exchanged, ...
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,49 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include <llvm/IR/Module.h>
+
+#include <map>
+#include <set>
+
+namespace race {
+
+// Finds stack (alloca) and heap (malloc, new, ...) objects whose address never escapes the function that creates
+// them. No other thread can ever get a pointer to such an object, so accesses to it can never race.
+//
+// A pointer escapes if it is stored to memory, returned, converted to an integer, or passed to a function that is
+// not defined in the module (e.g. pthread_create or __kmpc_fork_call). Passing a pointer to a defined function only
+// escapes if the corresponding argument escapes in the callee.
+class EscapeAnalysis {
+  std::set<const llvm::Value *> privateObjects;
+  // Memoized result for function arguments
+  std::map<const llvm::Argument *, bool> argEscapes;
+
+  // return true if the pointer ptr may escape through any of its uses
+  bool mayEscape(const llvm::Value *ptr);
+  bool mayEscape(const llvm::Argument *arg);
+
+ public:
+  explicit EscapeAnalysis(const llvm::Module &module);
+
+  // return true if obj is an alloca or heap allocation whose address never escapes its function
+  [[nodiscard]] bool isThreadPrivate(const llvm::Value *obj) const { return privateObjects.count(obj) > 0; }
+
+  // return true if ptr must point into an object that is thread private
+  [[nodiscard]] bool isThreadPrivateAccess(const llvm::Value *ptr) const;
+
+  // Number of objects found to be thread private
+  [[nodiscard]] size_t numThreadPrivate() const { return privateObjects.size(); }
+};
+
+}  // namespace race
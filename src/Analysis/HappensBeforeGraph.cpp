@@ -55,32 +55,18 @@ This shrinks the graph that needs to be searched.
 using namespace race;
 
 namespace {
-const ThreadTrace *getForkedThread(const ForkEvent *fork, const ProgramTrace &program) {
-  auto const &threads = program.getThreads();
-  auto thread = std::find_if(threads.begin(), threads.end(), [&fork](auto const &thread) {
-    return thread->spawnSite.has_value() && thread->spawnSite.value() == fork;
-  });
-
-  assert(thread != threads.end() && "Some forkEvent in does not correspond to a thread");
-  return *thread;
-}
-
+// Get the first fork on thread with a matching handle
 const ForkEvent *getForkWithHandle(const llvm::Value *handle, const ThreadTrace &thread) {
-  auto const &events = thread.getForkEvents();
-  auto it = std::find_if(events.begin(), events.end(),
-                         [&handle](auto forkEvent) { return forkEvent->getIRInst()->getThreadHandle() == handle; });
+  auto const forks = thread.program.getForksWithHandle(handle);
+  auto it = std::find_if(forks.begin(), forks.end(), [&thread](auto fork) { return &fork->getThread() == &thread; });
 
-  return (it != events.end()) ? *it : nullptr;
+  return (it != forks.end()) ? *it : nullptr;
 }
 
+// Get the first fork in the program with a matching handle
 const ForkEvent *getForkWithHandle(const llvm::Value *handle, const ProgramTrace &program) {
-  for (auto const &thread : program.getThreads()) {
-    auto fork = getForkWithHandle(handle, *thread);
-    if (fork != nullptr) {
-      return fork;
-    }
-  }
-  return nullptr;
+  auto const forks = program.getForksWithHandle(handle);
+  return forks.empty() ? nullptr : forks.front();
 }
 
 const ForkEvent *getCorrespondingFork(const JoinEvent *join, const ProgramTrace &program) {
@@ -130,14 +116,15 @@ const ForkEvent *getCorrespondingFork(const JoinEvent *join, const ProgramTrace
 
   // If we still have not found the joined thread, use heuristics
   // pick the thread that was spawned by the closet fork event from this join site
-  auto const forks = join->getThread().getForkEvents();
-  for (auto it = forks.rbegin(), rend = forks.rend(); it != rend; ++it) {
-    auto const fork = *it;
-    if (fork->getID() < join->getID()) {
-      llvm::errs() << "Using nearest fork heuristic to find corresponding fork!\n\tJoin: " << *join->getInst()
-                   << "\n\tFork: " << *fork->getInst() << "\n";
-      return fork;
-    }
+  // forks are sorted by ID, so binary search for the last fork before the join
+  auto const &forks = join->getThread().getForkEvents();
+  auto it = std::lower_bound(forks.begin(), forks.end(), join->getID(),
+                             [](const ForkEvent *fork, EventID id) { return fork->getID() < id; });
+  if (it != forks.begin()) {
+    auto const fork = *std::prev(it);
+    llvm::errs() << "Using nearest fork heuristic to find corresponding fork!\n\tJoin: " << *join->getInst()
+                 << "\n\tFork: " << *fork->getInst() << "\n";
+    return fork;
   }
 
   llvm::errs() << "Unable to find corresponding fork for join event: " << *join->getInst() << "\n";
@@ -147,14 +134,14 @@ const ForkEvent *getCorrespondingFork(const JoinEvent *join, const ProgramTrace
 const ThreadTrace *getJoinedThread(const JoinEvent *join, const ProgramTrace &program) {
   auto fork = getCorrespondingFork(join, program);
   if (fork != nullptr) {
-    return getForkedThread(fork, program);
+    return program.getForkedThread(fork);
   }
   return nullptr;
 }
 
 }  // namespace
 
-HappensBeforeGraph::HappensBeforeGraph(const race::ProgramTrace &program) {
+HappensBeforeGraph::HappensBeforeGraph(const race::ProgramTrace &program, Backend backend) : backend(backend) {
   // Barriers are handled by adding two edges between each barrier event
   // e.g.
   //   T1       T2
@@ -191,7 +178,7 @@ HappensBeforeGraph::HappensBeforeGraph(const race::ProgramTrace &program) {
       switch (event->type) {
         case Event::Type::Fork: {
           auto forkEvent = llvm::cast<ForkEvent>(event.get());
-          auto forkedThread = getForkedThread(forkEvent, program);
+          auto forkedThread = program.getForkedThread(forkEvent);
           if (forkedThread == nullptr) {
             // TODO: log warning
             llvm::errs() << "Could not find fork!\n";
@@ -229,6 +216,23 @@ HappensBeforeGraph::HappensBeforeGraph(const race::ProgramTrace &program) {
     }
   }
 
+  switch (backend) {
+    case Backend::Reachability:
+      computeSyncReachable();
+      break;
+    case Backend::VectorClock: {
+      // thread IDs are handed out sequentially, so they can be used directly as clock components
+      size_t numThreads = 0;
+      for (auto const &thread : program.getThreads()) {
+        numThreads = std::max(numThreads, thread->id + 1);
+      }
+      computeSyncClocks(numThreads);
+      break;
+    }
+  }
+}
+
+void HappensBeforeGraph::computeSyncReachable() {
   // we repeatedly need to check if one node is reachable from another
   // to optimise this, and since the connectivity of this graph is relatively low, we pre-search all reachable sync
   // events from each sync event and keep a cache for later since this graph is (effectively) unmodifiable
@@ -282,6 +286,68 @@ HappensBeforeGraph::HappensBeforeGraph(const race::ProgramTrace &program) {
   }
 }
 
+void HappensBeforeGraph::computeSyncClocks(size_t numThreads) {
+  // Start each sync event with a clock that only counts itself and the sync events before it on the same thread
+  for (auto const &[tid, syncs] : threadSyncs) {
+    auto &clocks = syncClocks[tid];
+    clocks.reserve(syncs.size());
+    for (size_t i = 0; i < syncs.size(); ++i) {
+      VectorClock clock(numThreads, 0);
+      clock.at(tid) = static_cast<uint32_t>(i + 1);
+      clocks.push_back(std::move(clock));
+    }
+  }
+
+  std::deque<EventPID> worklist;
+  for (auto const &[tid, syncs] : threadSyncs) {
+    std::copy(syncs.begin(), syncs.end(), std::back_inserter(worklist));
+  }
+
+  // Join the clock of src into dst, and revisit dst if its clock grew
+  auto const propagate = [this, &worklist](EventPID src, EventPID dst) {
+    auto const &srcClock = syncClocks.at(src.tid).at(syncIndex(src));
+    auto &dstClock = syncClocks.at(dst.tid).at(syncIndex(dst));
+
+    bool changed = false;
+    for (size_t t = 0, n = srcClock.size(); t < n; ++t) {
+      if (srcClock[t] > dstClock[t]) {
+        dstClock[t] = srcClock[t];
+        changed = true;
+      }
+    }
+
+    if (changed) {
+      worklist.push_back(dst);
+    }
+  };
+
+  // Barrier edges introduce cycles, so keep propagating along sync edges and
+  // thread order until no clock changes. Clocks only grow and are bounded, so this terminates.
+  while (!worklist.empty()) {
+    auto const node = worklist.front();
+    worklist.pop_front();
+
+    // cppcheck-suppress stlIfFind
+    if (auto it = syncEdges.find(node); it != syncEdges.end()) {
+      for (auto const next : it->second) {
+        propagate(node, next);
+      }
+    }
+
+    // cppcheck-suppress stlIfFind
+    if (auto opt = findNextSyncAfter(node); opt.has_value()) {
+      propagate(node, opt.value());
+    }
+  }
+}
+
+size_t HappensBeforeGraph::syncIndex(EventPID sync) const {
+  auto const &syncs = threadSyncs.at(sync.tid);
+  auto it = std::lower_bound(syncs.begin(), syncs.end(), sync);
+  assert(it != syncs.end() && *it == sync && "event is not a sync event");
+  return std::distance(syncs.begin(), it);
+}
+
 void HappensBeforeGraph::addSync(const Event *syncEvent) {
   auto &syncs = threadSyncs[syncEvent->getThread().id];
   EventPID syncPID(syncEvent);
@@ -324,6 +390,11 @@ bool HappensBeforeGraph::canReach(const Event *src, const Event *dst) const {
 }
 
 bool HappensBeforeGraph::isReachable(EventPID src, EventPID dst) const {
+  if (backend == Backend::VectorClock) {
+    auto const &dstClock = syncClocks.at(dst.tid).at(syncIndex(dst));
+    return dstClock.at(src.tid) > syncIndex(src);
+  }
+
   // cppcheck-suppress stlIfFind
   if (auto const reachable = syncReachable.find(src); reachable != syncReachable.end()) {
     return reachable->second.find(dst) != reachable->second.end();
@@ -11,14 +11,24 @@ limitations under the License.
 
 #pragma once
 
+#include <cstdint>
+
 #include "Trace/ProgramTrace.h"
 
 namespace race {
 
 class HappensBeforeGraph {
  public:
+  // How reachability between sync events is precomputed
+  enum class Backend {
+    // search and store every sync event reachable from each sync event
+    Reachability,
+    // assign each sync event a vector clock with one component per thread
+    VectorClock
+  };
+
   // constructs an graph from the events currently stored in program
-  explicit HappensBeforeGraph(const ProgramTrace &program);
+  explicit HappensBeforeGraph(const ProgramTrace &program, Backend backend = Backend::Reachability);
 
   // return true if there is a happens before edge from src to dst
   [[nodiscard]] bool canReach(const Event *src, const Event *dst) const;
@@ -49,9 +59,26 @@ class HappensBeforeGraph {
     bool operator<=(const EventPID &other) const { return *this < other || *this == other; }
   };
 
+  const Backend backend;
+
   std::map<EventPID, std::set<EventPID>> syncEdges;
+
+  // Only used by the Reachability backend
   std::map<EventPID, std::set<EventPID>> syncReachable;
-  // DFS on syncEdges to see if src can reach dst
+  void computeSyncReachable();
+
+  // Only used by the VectorClock backend
+  // Component t of a sync event's clock is the number of sync events on thread t that can reach it
+  // (i.e. the position in threadSyncs of the last one, plus one), so the clock of every sync event
+  // that a sync event src can reach has component src.tid > position of src
+  using VectorClock = std::vector<uint32_t>;
+  // Per-thread clocks, in the same order as threadSyncs
+  std::map<ThreadID, std::vector<VectorClock>> syncClocks;
+  void computeSyncClocks(size_t numThreads);
+  // position of a sync event in its thread's list of sync events
+  [[nodiscard]] size_t syncIndex(EventPID sync) const;
+
+  // check the precomputed reachability of sync event dst from sync event src
   [[nodiscard]] bool isReachable(EventPID src, EventPID dst) const;
   [[nodiscard]] bool hasEdge(EventPID src, EventPID dst) const;
 
@@ -11,49 +11,96 @@ limitations under the License.
 
 #include "LockSet.h"
 
-#include <set>
+#include <algorithm>
 
 using namespace race;
 
-std::multiset<const llvm::Value *> LockSet::heldLocks(const Event *targetEvent) {
-  // check if we have it cached
+namespace {
+
+void debugPrintLocks(llvm::StringRef action, const std::vector<const llvm::Value *> &locks) {
+  llvm::outs() << "After " << action << ": {";
+  for (auto lock : locks) llvm::outs() << lock << " ";
+  llvm::outs() << "}\n";
+}
+
+}  // namespace
+
+LockSet::LockSet(const ProgramTrace &program) {
+  // the empty lock set always has ID 0
+  intern({});
+
+  for (auto const &thread : program.getThreads()) {
+    computeHeldLocks(*thread);
+  }
+}
+
+LockSet::LockSetID LockSet::intern(const std::vector<const llvm::Value *> &locks) {
   // cppcheck-suppress stlIfFind
-  if (auto it = cache.find(targetEvent); it != cache.end()) {
+  if (auto it = locksetIDs.find(locks); it != locksetIDs.end()) {
     return it->second;
   }
-  std::multiset<const llvm::Value *> locks;
+
+  auto const id = static_cast<LockSetID>(locksets.size());
+  locksets.push_back(locks);
+  locksetIDs.emplace(locks, id);
+  return id;
+}
+
+void LockSet::computeHeldLocks(const ThreadTrace &thread) {
   if (DEBUG_PTA) {
     llvm::outs() << "--------------------------\n";
   }
-  auto const &thread = targetEvent->getThread();
-  for (auto const &event : thread.getEvents()) {
-    if (event->getID() == targetEvent->getID()) {
-      break;
-    }
+
+  // Most lock/unlock events move between the same few lock sets, so remember each transition
+  // instead of rebuilding and looking up the new set every time
+  std::map<std::pair<LockSetID, const llvm::Value *>, LockSetID> afterLock;
+  std::map<std::pair<LockSetID, const llvm::Value *>, LockSetID> afterUnlock;
+
+  auto const &events = thread.getEvents();
+  auto &held = heldLocks[thread.id];
+  held.reserve(events.size());
+
+  LockSetID current = 0;
+  for (auto const &event : events) {
+    // locks held *before* this event
+    held.push_back(current);
+
     switch (event->type) {
       case Event::Type::Lock: {
-        auto lockEvent = llvm::cast<LockEvent>(event.get());
-        locks.insert(lockEvent->getIRInst()->getLockValue());
+        auto const lockValue = llvm::cast<LockEvent>(event.get())->getIRInst()->getLockValue();
+        auto const key = std::make_pair(current, lockValue);
+        if (auto it = afterLock.find(key); it != afterLock.end()) {
+          current = it->second;
+        } else {
+          auto locks = locksets.at(current);
+          locks.insert(std::upper_bound(locks.begin(), locks.end(), lockValue), lockValue);
+          current = intern(locks);
+          afterLock.emplace(key, current);
+        }
+
         if (DEBUG_PTA) {
-          llvm::outs() << "After lock: {";
-          auto it = locks.begin();
-          for (; it != locks.end(); it++) llvm::outs() << *it << " ";
-          llvm::outs() << "}\n";
+          debugPrintLocks("lock", locksets.at(current));
         }
         break;
       }
       case Event::Type::Unlock: {
-        auto unlockEvent = llvm::cast<UnlockEvent>(event.get());
-        const llvm::Value *ele = unlockEvent->getIRInst()->getLockValue();
-        const auto &first = locks.find(ele);
-        if (first != locks.end()) {  // only remove the first element
-          locks.erase(first);
+        auto const lockValue = llvm::cast<UnlockEvent>(event.get())->getIRInst()->getLockValue();
+        auto const key = std::make_pair(current, lockValue);
+        if (auto it = afterUnlock.find(key); it != afterUnlock.end()) {
+          current = it->second;
+        } else {
+          auto locks = locksets.at(current);
+          // only remove the first element
+          if (auto lock = std::lower_bound(locks.begin(), locks.end(), lockValue);
+              lock != locks.end() && *lock == lockValue) {
+            locks.erase(lock);
+          }
+          current = intern(locks);
+          afterUnlock.emplace(key, current);
         }
+
         if (DEBUG_PTA) {
-          llvm::outs() << "After unlock: {";
-          auto it = locks.begin();
-          for (; it != locks.end(); it++) llvm::outs() << *it << " ";
-          llvm::outs() << "}\n";
+          debugPrintLocks("unlock", locksets.at(current));
         }
         break;
       }
@@ -62,24 +109,23 @@ std::multiset<const llvm::Value *> LockSet::heldLocks(const Event *targetEvent)
         break;
     }
   }
-
-  cache.emplace(targetEvent, locks);
-  return locks;
 }
 
-LockSet::LockSet(const ProgramTrace & /* program */) : cache({}) {}
+LockSet::LockSetID LockSet::getLockSetID(const Event *event) const {
+  return heldLocks.at(event->getThread().id).at(event->getID());
+}
 
-bool LockSet::sharesLock(const MemAccessEvent *lhs, const MemAccessEvent *rhs) {
-  auto const lhsLocks = heldLocks(lhs);
-  auto const rhsLocks = heldLocks(rhs);
+bool LockSet::computeSharesLock(LockSetID lhs, LockSetID rhs) const {
+  auto const &lhsLocks = locksets.at(lhs);
+  auto const &rhsLocks = locksets.at(rhs);
 
   auto lhsIter = lhsLocks.begin();
   auto rhsIter = rhsLocks.begin();
 
   while (lhsIter != lhsLocks.end() && rhsIter != rhsLocks.end()) {
-    if (rhsIter == rhsLocks.end() || *lhsIter < *rhsIter) {
+    if (*lhsIter < *rhsIter) {
       lhsIter++;
-    } else if (lhsIter == lhsLocks.end() || *lhsIter > *rhsIter) {
+    } else if (*lhsIter > *rhsIter) {
       rhsIter++;
     } else {
       return true;
@@ -88,3 +134,25 @@ bool LockSet::sharesLock(const MemAccessEvent *lhs, const MemAccessEvent *rhs) {
 
   return false;
 }
+
+bool LockSet::sharesLock(const Event *lhs, const Event *rhs) const {
+  auto lhsID = getLockSetID(lhs);
+  auto rhsID = getLockSetID(rhs);
+
+  // the empty lock set shares no locks with anything
+  if (lhsID == 0 || rhsID == 0) return false;
+  if (lhsID == rhsID) return true;
+
+  if (lhsID > rhsID) std::swap(lhsID, rhsID);
+  auto const key = std::make_pair(lhsID, rhsID);
+
+  std::lock_guard<std::mutex> guard(sharedLocksMutex);
+  // cppcheck-suppress stlIfFind
+  if (auto it = sharedLocks.find(key); it != sharedLocks.end()) {
+    return it->second;
+  }
+
+  auto const result = computeSharesLock(lhsID, rhsID);
+  sharedLocks.emplace(key, result);
+  return result;
+}
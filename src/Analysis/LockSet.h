@@ -11,19 +11,53 @@ limitations under the License.
 
 #pragma once
 
+#include <cstdint>
+#include <mutex>
+
 #include "LanguageModel/RaceModel.h"
 #include "Trace/ProgramTrace.h"
 
 namespace race {
 
+// Computes the locks held before every event in the program.
+// Each thread is scanned once, front to back. Distinct sets of held locks are interned
+// so that every event only stores a small ID, and sharesLock is answered once per pair of IDs.
 class LockSet {
+ public:
+  using LockSetID = uint32_t;
+
  private:
-  std::map<const Event *, std::multiset<const llvm::Value *>> cache;
-  std::multiset<const llvm::Value *> heldLocks(const Event *targetEvent);
+  // Interned lock sets, each stored as a sorted list of lock values.
+  // A lock value can appear more than once if it was locked recursively.
+  std::vector<std::vector<const llvm::Value *>> locksets;
+  std::map<std::vector<const llvm::Value *>, LockSetID> locksetIDs;
+
+  // ID of the locks held before each event, indexed by thread ID then by event ID
+  std::map<ThreadID, std::vector<LockSetID>> heldLocks;
+
+  // Memoized sharesLock results, keyed by (smaller ID, larger ID)
+  mutable std::map<std::pair<LockSetID, LockSetID>, bool> sharedLocks;
+  // sharesLock may be called by multiple race checking workers at once
+  mutable std::mutex sharedLocksMutex;
+
+  // return the ID of locks, creating a new one if this set has not been seen before
+  LockSetID intern(const std::vector<const llvm::Value *> &locks);
+
+  // record the held locks of every event on thread
+  void computeHeldLocks(const ThreadTrace &thread);
+
+  [[nodiscard]] bool computeSharesLock(LockSetID lhs, LockSetID rhs) const;
 
  public:
   explicit LockSet(const ProgramTrace &program);
 
-  [[nodiscard]] bool sharesLock(const MemAccessEvent *lhs, const MemAccessEvent *rhs);
+  // ID of the locks held right before event
+  [[nodiscard]] LockSetID getLockSetID(const Event *event) const;
+
+  // the sorted list of lock values making up the lock set
+  [[nodiscard]] const std::vector<const llvm::Value *> &getLocks(LockSetID id) const { return locksets.at(id); }
+
+  // whether the locks held right before lhs and rhs have a lock in common
+  [[nodiscard]] bool sharesLock(const Event *lhs, const Event *rhs) const;
 };
 }  // namespace race
@@ -0,0 +1,71 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "Analysis/RaceFilter.h"
+
+using namespace race;
+
+double RaceFilterPipeline::Stats::rejectionRate() const {
+  if (invocations == 0) return 0.0;
+  return static_cast<double>(rejections) / static_cast<double>(invocations);
+}
+
+double RaceFilterPipeline::Stats::rejectionsPerNs() const {
+  // very cheap filters can finish within the clock resolution
+  auto const ns = std::max<std::chrono::nanoseconds::rep>(time.count(), 1);
+  return static_cast<double>(rejections) / static_cast<double>(ns);
+}
+
+void RaceFilterPipeline::add(std::unique_ptr<RaceFilter> filter) {
+  filters.push_back(Entry{std::move(filter), Stats{}});
+}
+
+bool RaceFilterPipeline::rejects(const WriteEvent *write, const MemAccessEvent *other) {
+  if (reorderInterval > 0 && ++checksSinceReorder >= reorderInterval) {
+    reorder();
+    checksSinceReorder = 0;
+  }
+
+  for (auto &entry : filters) {
+    auto const start = std::chrono::steady_clock::now();
+    auto const rejected = entry.filter->rejects(write, other);
+    entry.stats.time += std::chrono::steady_clock::now() - start;
+
+    ++entry.stats.invocations;
+    if (rejected) {
+      ++entry.stats.rejections;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void RaceFilterPipeline::reorder() {
+  // stable so that filters with equal (e.g. no) rejections keep their relative order
+  std::stable_sort(filters.begin(), filters.end(), [](const Entry &lhs, const Entry &rhs) {
+    return lhs.stats.rejectionsPerNs() > rhs.stats.rejectionsPerNs();
+  });
+}
+
+nlohmann::json RaceFilterPipeline::getStatsJSON() const {
+  auto stats = nlohmann::json::array();
+  for (auto const &entry : filters) {
+    stats.push_back({
+        {"name", entry.filter->getName().str()},
+        {"invocations", entry.stats.invocations},
+        {"rejections", entry.stats.rejections},
+        {"rejectionRate", entry.stats.rejectionRate()},
+        {"timeNs", entry.stats.time.count()},
+    });
+  }
+  return stats;
+}
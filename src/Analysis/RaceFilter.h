@@ -0,0 +1,189 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "Analysis/OpenMPAnalysis.h"
+#include "Analysis/SimpleAlias.h"
+#include "Trace/Event.h"
+
+namespace race {
+
+// A check that can prove a write and another access to the same memory cannot race
+class RaceFilter {
+ public:
+  virtual ~RaceFilter() = default;
+
+  // Name used when reporting statistics
+  [[nodiscard]] virtual llvm::StringRef getName() const = 0;
+
+  // return true if write and other cannot race
+  [[nodiscard]] virtual bool rejects(const WriteEvent *write, const MemAccessEvent *other) = 0;
+};
+
+// Accesses that ScopedNoAliasAA proves do not alias cannot race
+class SimpleAliasFilter : public RaceFilter {
+  SimpleAlias &simpleAlias;
+
+ public:
+  explicit SimpleAliasFilter(SimpleAlias &simpleAlias) : simpleAlias(simpleAlias) {}
+
+  [[nodiscard]] llvm::StringRef getName() const override { return "SimpleAlias"; }
+  [[nodiscard]] bool rejects(const WriteEvent *write, const MemAccessEvent *other) override {
+    return simpleAlias.mustNotAlias(write, other);
+  }
+};
+
+// Base for filters that only apply to accesses from the same OpenMP team
+class OpenMPFilter : public RaceFilter {
+ protected:
+  OpenMPAnalysis &ompAnalysis;
+
+  // Only called if write and other are from the same parallel region
+  [[nodiscard]] virtual bool rejectsInTeam(const WriteEvent *write, const MemAccessEvent *other) = 0;
+
+ public:
+  explicit OpenMPFilter(OpenMPAnalysis &ompAnalysis) : ompAnalysis(ompAnalysis) {}
+
+  [[nodiscard]] bool rejects(const WriteEvent *write, const MemAccessEvent *other) final {
+    return ompAnalysis.fromSameParallelRegion(write, other) && rejectsInTeam(write, other);
+  }
+};
+
+// Non overlapping array accesses inside of an OpenMP loop are not races
+// e.g.
+//  #pragma omp parallel for shared(A)
+//  for (int i = 0; i < N: i++) { A[i] = i; }
+// even though A is shared, each index is unique so there is no race
+class OpenMPLoopFilter : public OpenMPFilter {
+ protected:
+  [[nodiscard]] bool rejectsInTeam(const WriteEvent *write, const MemAccessEvent *other) override {
+    return ompAnalysis.isNonOverlappingLoopAccess(write, other);
+  }
+
+ public:
+  using OpenMPFilter::OpenMPFilter;
+  [[nodiscard]] llvm::StringRef getName() const override { return "OpenMPLoop"; }
+};
+
+// Certain omp blocks cannot race with themselves or those of the same type within the same scope/team
+class OpenMPSingleFilter : public OpenMPFilter {
+ protected:
+  [[nodiscard]] bool rejectsInTeam(const WriteEvent *write, const MemAccessEvent *other) override {
+    return ompAnalysis.inSameSingleBlock(write, other);
+  }
+
+ public:
+  using OpenMPFilter::OpenMPFilter;
+  [[nodiscard]] llvm::StringRef getName() const override { return "OpenMPSingle"; }
+};
+
+class OpenMPReduceFilter : public OpenMPFilter {
+ protected:
+  [[nodiscard]] bool rejectsInTeam(const WriteEvent *write, const MemAccessEvent *other) override {
+    return ompAnalysis.inSameReduce(write, other);
+  }
+
+ public:
+  using OpenMPFilter::OpenMPFilter;
+  [[nodiscard]] llvm::StringRef getName() const override { return "OpenMPReduce"; }
+};
+
+class OpenMPSectionsFilter : public OpenMPFilter {
+ protected:
+  [[nodiscard]] bool rejectsInTeam(const WriteEvent *write, const MemAccessEvent *other) override {
+    return OpenMPAnalysis::insideCompatibleSections(write, other);
+  }
+
+ public:
+  using OpenMPFilter::OpenMPFilter;
+  [[nodiscard]] llvm::StringRef getName() const override { return "OpenMPSections"; }
+};
+
+// No race if guaranteed to be executed by same thread
+class OpenMPGuardedTIDFilter : public OpenMPFilter {
+ protected:
+  [[nodiscard]] bool rejectsInTeam(const WriteEvent *write, const MemAccessEvent *other) override {
+    return ompAnalysis.guardedBySameTID(write, other);
+  }
+
+ public:
+  using OpenMPFilter::OpenMPFilter;
+  [[nodiscard]] llvm::StringRef getName() const override { return "OpenMPGuardedTID"; }
+};
+
+// Lastprivate code will only be executed by one thread
+// Model lastprivate by assuming lastprivate code cannot race with other last private code
+// This may miss races according to OpenMP specification,
+//  but will not miss races according to how Clang generates OpenMP code (as of clang 10.0.1)
+class OpenMPLastprivateFilter : public OpenMPFilter {
+ protected:
+  [[nodiscard]] bool rejectsInTeam(const WriteEvent *write, const MemAccessEvent *other) override {
+    return ompAnalysis.isInLastprivate(write) && ompAnalysis.isInLastprivate(other);
+  }
+
+ public:
+  using OpenMPFilter::OpenMPFilter;
+  [[nodiscard]] llvm::StringRef getName() const override { return "OpenMPLastprivate"; }
+};
+
+// Runs a list of filters until one of them rejects a pair of accesses.
+// Records how often and how long each filter runs, and periodically moves the filters that reject the most pairs per
+// nanosecond to the front. Reordering never changes the result, only how quickly it is reached.
+// The pipeline is not thread safe, callers must serialize calls to rejects.
+class RaceFilterPipeline {
+ public:
+  struct Stats {
+    size_t invocations = 0;
+    size_t rejections = 0;
+    std::chrono::nanoseconds time{0};
+
+    [[nodiscard]] double rejectionRate() const;
+    [[nodiscard]] double rejectionsPerNs() const;
+  };
+
+  // Number of pairs checked between reorderings by default
+  static constexpr size_t DEFAULT_REORDER_INTERVAL = 1024;
+
+  // Filters are reordered every reorderInterval checked pairs. 0 keeps the order filters were added in.
+  explicit RaceFilterPipeline(size_t reorderInterval = DEFAULT_REORDER_INTERVAL) : reorderInterval(reorderInterval) {}
+
+  // Filters run in the order they are added until the first reordering
+  void add(std::unique_ptr<RaceFilter> filter);
+
+  // return true if any filter rejects the pair
+  [[nodiscard]] bool rejects(const WriteEvent *write, const MemAccessEvent *other);
+
+  // Sort filters by rejections per nanosecond, most effective first
+  void reorder();
+
+  // Per filter statistics, in the current order
+  [[nodiscard]] nlohmann::json getStatsJSON() const;
+
+ private:
+  struct Entry {
+    std::unique_ptr<RaceFilter> filter;
+    Stats stats;
+  };
+
+  std::vector<Entry> filters;
+
+  const size_t reorderInterval;
+  size_t checksSinceReorder = 0;
+};
+
+}  // namespace race
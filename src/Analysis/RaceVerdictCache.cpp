@@ -0,0 +1,51 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "Analysis/RaceVerdictCache.h"
+
+#include "Trace/ThreadTrace.h"
+
+using namespace race;
+
+namespace {
+
+RaceVerdictCache::TeamPosition getTeamPosition(const Event *event) {
+  auto const &spawnSite = event->getThread().spawnSite;
+  auto const spawn = spawnSite.has_value() ? spawnSite.value()->getInst() : nullptr;
+  return RaceVerdictCache::TeamPosition{spawn, event->getID()};
+}
+
+}  // namespace
+
+RaceVerdictCache::Key RaceVerdictCache::getKey(const WriteEvent *write, const MemAccessEvent *other, bool sameTeam) {
+  Key key{write->getInst(), other->getInst(), std::nullopt};
+  if (sameTeam) {
+    key.team = std::make_pair(getTeamPosition(write), getTeamPosition(other));
+  }
+  return key;
+}
+
+std::optional<bool> RaceVerdictCache::lookup(const Key &key) const {
+  std::lock_guard<std::mutex> guard(verdictsMutex);
+
+  // cppcheck-suppress stlIfFind
+  if (auto it = verdicts.find(key); it != verdicts.end()) {
+    ++hits;
+    return it->second;
+  }
+  ++misses;
+  return std::nullopt;
+}
+
+void RaceVerdictCache::insert(const Key &key, bool isRace) {
+  std::lock_guard<std::mutex> guard(verdictsMutex);
+  verdicts.emplace(key, isRace);
+}
@@ -0,0 +1,73 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <tuple>
+
+#include "Trace/Event.h"
+
+namespace race {
+
+// Caches the verdict of the per-access race filters (SimpleAlias and OpenMPAnalysis) so that pairs of instructions
+// that are checked many times, e.g. because OpenMP regions are duplicated or functions are traversed in several call
+// contexts, only run the filters once.
+//
+// Happens-before and lockset are not part of the key because they are already decided for each pair of sync
+// intervals before individual accesses are checked.
+class RaceVerdictCache {
+ public:
+  // Position of an access within an OpenMP team, which is what the OpenMP filters depend on.
+  // Threads spawned by the same fork instruction execute the same region, so their traces line up by event ID.
+  struct TeamPosition {
+    const llvm::Instruction *spawn = nullptr;
+    EventID eid = 0;
+
+    bool operator<(const TeamPosition &other) const {
+      return std::tie(spawn, eid) < std::tie(other.spawn, other.eid);
+    }
+  };
+
+  struct Key {
+    const llvm::Instruction *write;
+    const llvm::Instruction *other;
+    // Only set if both accesses are from the same OpenMP team
+    std::optional<std::pair<TeamPosition, TeamPosition>> team;
+
+    bool operator<(const Key &rhs) const {
+      return std::tie(write, other, team) < std::tie(rhs.write, rhs.other, rhs.team);
+    }
+  };
+
+  // Build the key for a pair of accesses. sameTeam should be the result of OpenMPAnalysis::fromSameParallelRegion
+  [[nodiscard]] static Key getKey(const WriteEvent *write, const MemAccessEvent *other, bool sameTeam);
+
+  // Get the cached verdict for key, if there is one
+  [[nodiscard]] std::optional<bool> lookup(const Key &key) const;
+
+  void insert(const Key &key, bool isRace);
+
+  [[nodiscard]] size_t getHits() const { return hits; }
+  [[nodiscard]] size_t getMisses() const { return misses; }
+
+ private:
+  mutable std::mutex verdictsMutex;
+  std::map<Key, bool> verdicts;
+
+  mutable std::atomic<size_t> hits = 0;
+  mutable std::atomic<size_t> misses = 0;
+};
+
+}  // namespace race
@@ -10,19 +10,158 @@ limitations under the License.
 ==============================================================================*/
 
 #include "Analysis/SharedMemory.h"
+
+#include <numeric>
+#include <set>
+#include <tuple>
 using namespace race;
 
-SharedMemory::SharedMemory(const ProgramTrace &program) {
-  auto const getObjId = [&](const pta::ObjTy *obj) {
-    // cppcheck-suppress stlIfFind
-    if (auto it = objIDs.find(obj); it != objIDs.end()) {
-      return it->second;
+namespace {
+
+// A single read or write event, collected while scanning the program before object IDs are known
+// anchor is the event itself, or the EnterCall event of the shared call it was added for, see SyncInterval::anchor
+template <class EventT>
+struct EventAccess {
+  ThreadID tid;
+  size_t interval;
+  const EventT *event;
+  const Event *anchor;
+};
+
+// A single access to a single object
+template <class EventT>
+struct Access {
+  SharedMemory::ObjID objID;
+  ThreadID tid;
+  size_t interval;
+  const EventT *event;
+  const Event *anchor;
+
+  [[nodiscard]] auto key() const { return std::make_tuple(objID, tid, interval, event->getID()); }
+};
+
+// Adds the accesses of shared call segments (see CallSegmentRef) to the interval of the calls they are shared with
+struct SharedSegmentAccesses {
+  const ThreadTrace &thread;
+  // accesses merged into a representative, they are reported along with it and are not added again
+  const std::set<const MemAccessEvent *> &coalescedAccesses;
+  std::vector<EventAccess<ReadEvent>> &reads;
+  std::vector<EventAccess<WriteEvent>> &writes;
+
+  size_t intervalID = 0;
+  // ID of the first event of the current interval, segments made from here on are already in the interval
+  EventID intervalStart = 0;
+  // the segments already added to the current interval
+  std::vector<std::pair<EventID, EventID>> added;
+
+  void startInterval(size_t id, EventID start) {
+    intervalID = id;
+    intervalStart = start;
+    added.clear();
+  }
+
+  // Add the accesses of the shared call ref on behalf of anchor, including those of calls shared inside it
+  void add(const CallSegmentRef &ref, const Event *anchor) {
+    if (ref.begin >= intervalStart) return;
+    // segments are the events of a call, so two of them are either nested or disjoint
+    auto const contains = [&](auto const &range) { return range.first <= ref.begin && ref.end <= range.second; };
+    if (std::any_of(added.begin(), added.end(), contains)) return;
+    added.emplace_back(ref.begin, ref.end);
+
+    for (auto eid = ref.begin; eid < ref.end; ++eid) {
+      auto const event = thread.getEvent(eid);
+      if (auto const access = llvm::dyn_cast<MemAccessEvent>(event); !access || coalescedAccesses.count(access)) {
+        continue;
+      }
+
+      if (auto const read = llvm::dyn_cast<ReadEvent>(event)) {
+        reads.push_back(EventAccess<ReadEvent>{thread.id, intervalID, read, anchor});
+      } else if (auto const write = llvm::dyn_cast<WriteEvent>(event)) {
+        writes.push_back(EventAccess<WriteEvent>{thread.id, intervalID, write, anchor});
+      }
     }
 
-    auto id = objIDs.size();
-    objIDs[obj] = id;
-    return id;
+    for (auto const &nested : thread.getSegmentRefs(ref.begin, ref.end)) {
+      add(nested, anchor);
+    }
+  }
+};
+
+// Expand each event to one access per object in its points-to set
+// setObjIDs holds the object IDs of each interned points-to set, so objects are only looked up once per set
+template <class EventT>
+std::vector<Access<EventT>> expandAccesses(const std::vector<EventAccess<EventT>> &events,
+                                           const std::vector<std::vector<SharedMemory::ObjID>> &setObjIDs) {
+  std::vector<Access<EventT>> accesses;
+  for (auto const &access : events) {
+    for (auto const objID : setObjIDs.at(access.event->getPointsToSetID())) {
+      accesses.push_back(Access<EventT>{objID, access.tid, access.interval, access.event, access.anchor});
+    }
+  }
+  return accesses;
+}
+
+// Sort accesses by (object, thread, interval, event) and lay them out in table
+template <class EventT>
+void buildAccessTable(std::vector<Access<EventT>> &accesses, size_t numObjects, AccessTable<EventT> &table) {
+  std::sort(accesses.begin(), accesses.end(), [](auto const &lhs, auto const &rhs) { return lhs.key() < rhs.key(); });
+  // interned points-to sets do not contain duplicate objects, but an access of a shared call segment can be added to
+  // an interval by more than one of the calls it is shared with
+  accesses.erase(std::unique(accesses.begin(), accesses.end(),
+                             [](auto const &lhs, auto const &rhs) { return lhs.key() == rhs.key(); }),
+                 accesses.end());
+
+  // events must be complete before any interval refers to them
+  table.events.reserve(accesses.size());
+  for (auto const &access : accesses) {
+    table.events.push_back(access.event);
+  }
+
+  // Range of intervals belonging to each (object, thread)
+  struct ThreadRange {
+    SharedMemory::ObjID objID;
+    ThreadID tid;
+    size_t begin;
+    size_t end;
   };
+  std::vector<ThreadRange> threadRanges;
+
+  auto const events = llvm::ArrayRef<const EventT *>(table.events);
+  for (size_t i = 0, n = accesses.size(); i < n;) {
+    auto const objID = accesses[i].objID;
+    auto const tid = accesses[i].tid;
+    auto const firstInterval = table.intervals.size();
+
+    while (i < n && accesses[i].objID == objID && accesses[i].tid == tid) {
+      auto const intervalID = accesses[i].interval;
+      auto const begin = i;
+      while (i < n && accesses[i].objID == objID && accesses[i].tid == tid && accesses[i].interval == intervalID) {
+        ++i;
+      }
+      table.intervals.push_back(
+          SyncInterval<EventT>{intervalID, events.slice(begin, i - begin), accesses[begin].anchor});
+    }
+
+    threadRanges.push_back(ThreadRange{objID, tid, firstInterval, table.intervals.size()});
+  }
+
+  // intervals are now complete and can be referred to by threads
+  auto const intervals = llvm::ArrayRef<SyncInterval<EventT>>(table.intervals);
+  table.threads.reserve(threadRanges.size());
+  table.objOffsets.assign(numObjects + 1, 0);
+  for (auto const &range : threadRanges) {
+    table.threads.push_back(ThreadAccesses<EventT>{range.tid, intervals.slice(range.begin, range.end - range.begin)});
+    table.objOffsets.at(range.objID + 1)++;
+  }
+  std::partial_sum(table.objOffsets.begin(), table.objOffsets.end(), table.objOffsets.begin());
+}
+
+}  // namespace
+
+SharedMemory::SharedMemory(const ProgramTrace &program, bool coalesce) {
+  std::vector<EventAccess<ReadEvent>> reads;
+  std::vector<EventAccess<WriteEvent>> writes;
+  std::set<const MemAccessEvent *> coalescedAccesses;
 
   if (DEBUG_PTA) {
     llvm::outs() << "** SharedMemory **"
@@ -34,11 +173,46 @@ SharedMemory::SharedMemory(const ProgramTrace &program) {
       llvm::outs() << "------- tid: " << tid << "\n";
     }
 
+    // The representative of each run of consecutive accesses of the same kind to the same value.
+    // SimpleAliasFilter decides per instruction from its !alias.scope and !noalias metadata, so accesses are only
+    // merged if they carry the same metadata
+    using RunKey = std::tuple<Event::Type, const pta::ctx *, const llvm::Value *, const llvm::MDNode *,
+                              const llvm::MDNode *>;
+    std::map<RunKey, const MemAccessEvent *> runAccesses;
+    const llvm::BasicBlock *runBlock = nullptr;
+
+    // Return the access that access should be merged into, or nullptr if it starts a new run
+    auto const findRepresentative = [&](const MemAccessEvent *access) -> const MemAccessEvent * {
+      if (!coalesce) return nullptr;
+
+      auto const inst = access->getInst();
+      auto const block = inst->getParent();
+      if (block != runBlock) {
+        runAccesses.clear();
+        runBlock = block;
+      }
+
+      auto const key = std::make_tuple(access->type, access->getContext(), access->getIRInst()->getAccessedValue(),
+                                       inst->getMetadata(llvm::LLVMContext::MD_alias_scope),
+                                       inst->getMetadata(llvm::LLVMContext::MD_noalias));
+      auto const [it, inserted] = runAccesses.emplace(key, access);
+      return inserted ? nullptr : it->second;
+    };
+
+    SharedSegmentAccesses sharedAccesses{*thread, coalescedAccesses, reads, writes};
+    auto nextRef = thread->getSegmentRefs().begin();
+
+    size_t intervalID = 0;
     for (auto const &event : thread->getEvents()) {
+      if (!llvm::isa<MemAccessEvent>(event.get())) {
+        // any other event ends the current run of accesses
+        runAccesses.clear();
+      }
+
       switch (event->type) {
         case Event::Type::Read: {
           auto readEvent = llvm::cast<ReadEvent>(event.get());
-          auto const ptsTo = readEvent->getAccessedMemory();
+          auto const &ptsTo = readEvent->getAccessedMemory();
           if (DEBUG_PTA) {
             if (ptsTo.empty()) {
               llvm::outs() << "Read: ID " << readEvent->getID();
@@ -53,21 +227,26 @@ SharedMemory::SharedMemory(const ProgramTrace &program) {
             }
           }
           // TODO: filter?
-          for (auto obj : ptsTo) {
-            auto &reads = objReads[getObjId(obj)][tid];
-            reads.push_back(readEvent);
+          if (auto representative = findRepresentative(readEvent)) {
+            coalesced[representative].push_back(readEvent);
+            coalescedAccesses.insert(readEvent);
             if (DEBUG_PTA) {
-              llvm::outs() << obj->getValue() << " " << obj->getObjectID() << " " << getObjId(obj) << ", ";
+              llvm::outs() << "coalesced into ID " << representative->getID() << "\n";
             }
+            break;
           }
+          reads.push_back(EventAccess<ReadEvent>{tid, intervalID, readEvent, readEvent});
           if (DEBUG_PTA) {
+            for (auto obj : ptsTo) {
+              llvm::outs() << obj->getValue() << " " << obj->getObjectID() << ", ";
+            }
             llvm::outs() << "\n";
           }
           break;
         }
         case Event::Type::Write: {
           auto writeEvent = llvm::cast<WriteEvent>(event.get());
-          auto const ptsTo = writeEvent->getAccessedMemory();
+          auto const &ptsTo = writeEvent->getAccessedMemory();
           if (DEBUG_PTA) {
             if (ptsTo.empty()) {
               llvm::outs() << "Write: ID " << writeEvent->getID();
@@ -82,72 +261,121 @@ SharedMemory::SharedMemory(const ProgramTrace &program) {
             }
           }
           // TODO: filter?
-          for (auto obj : ptsTo) {
-            auto &writes = objWrites[getObjId(obj)][tid];
-            writes.push_back(writeEvent);
+          if (auto representative = findRepresentative(writeEvent)) {
+            coalesced[representative].push_back(writeEvent);
+            coalescedAccesses.insert(writeEvent);
             if (DEBUG_PTA) {
-              llvm::outs() << obj->getValue() << " " << obj->getObjectID() << " " << getObjId(obj) << ", ";
+              llvm::outs() << "coalesced into ID " << representative->getID() << "\n";
             }
+            break;
           }
+          writes.push_back(EventAccess<WriteEvent>{tid, intervalID, writeEvent, writeEvent});
           if (DEBUG_PTA) {
+            for (auto obj : ptsTo) {
+              llvm::outs() << obj->getValue() << " " << obj->getObjectID() << ", ";
+            }
             llvm::outs() << "\n";
           }
           break;
         }
+        case Event::Type::Fork:
+        case Event::Type::Join:
+        case Event::Type::Barrier:
+        case Event::Type::Lock:
+        case Event::Type::Unlock: {
+          // happens-before or the held locks may change after this event
+          intervalID++;
+          sharedAccesses.startInterval(intervalID, event->getID() + 1);
+          break;
+        }
+        case Event::Type::Call: {
+          if (nextRef != thread->getSegmentRefs().end() && nextRef->at == event->getID()) {
+            sharedAccesses.add(*nextRef, event.get());
+            ++nextRef;
+          }
+          break;
+        }
         default:
           // Do Nothing
           break;
       }
     }
   }
+
+  // Many events share the same interned points-to set, so objects are collected once per set instead of per event
+  auto const &pointsToSets = program.getPointsToSets();
+  std::vector<bool> usedSets(pointsToSets.size(), false);
+  for (auto const &access : reads) usedSets.at(access.event->getPointsToSetID()) = true;
+  for (auto const &access : writes) usedSets.at(access.event->getPointsToSetID()) = true;
+
+  // Assign dense object IDs. Pointer order can change from run to run, so order by pointer analysis ID instead
+  for (PointsToSetID setID = 0; setID < usedSets.size(); ++setID) {
+    if (!usedSets[setID]) continue;
+    for (auto const obj : pointsToSets.getObjects(setID)) objIDs.emplace(obj, 0);
+  }
+  objects.reserve(objIDs.size());
+  for (auto const &[obj, id] : objIDs) objects.push_back(obj);
+  std::sort(objects.begin(), objects.end(),
+            [](const pta::ObjTy *lhs, const pta::ObjTy *rhs) { return lhs->getObjectID() < rhs->getObjectID(); });
+  for (ObjID id = 0; id < objects.size(); ++id) {
+    objIDs[objects[id]] = id;
+  }
+
+  std::vector<std::vector<ObjID>> setObjIDs(pointsToSets.size());
+  for (PointsToSetID setID = 0; setID < usedSets.size(); ++setID) {
+    if (!usedSets[setID]) continue;
+    for (auto const obj : pointsToSets.getObjects(setID)) setObjIDs[setID].push_back(objIDs.at(obj));
+  }
+
+  auto readAccesses = expandAccesses(reads, setObjIDs);
+  auto writeAccesses = expandAccesses(writes, setObjIDs);
+  buildAccessTable(readAccesses, objects.size(), objReads);
+  buildAccessTable(writeAccesses, objects.size(), objWrites);
 }
+
 std::vector<const pta::ObjTy *> SharedMemory::getSharedObjects() const {
   std::vector<const pta::ObjTy *> sharedObjects;
-  for (auto const &[obj, objID] : objIDs) {
+  for (ObjID objID = 0; objID < objects.size(); ++objID) {
     auto const nWriters = numThreadsWrite(objID);
     auto const nReaders = numThreadsRead(objID);
 
     // Common case: If > 1 writer or 1 writer and 2 reader, guaranteed shared across threads
     if (nWriters > 1 || (nWriters == 1 && nReaders > 1)) {
-      sharedObjects.push_back(obj);
+      sharedObjects.push_back(objects[objID]);
     }
     // When 1 writer and 1 reader, obj is shared if they are not the same thread
     else if (nWriters == 1 && nReaders == 1 &&
-             objWrites.at(objID).begin()->first != objReads.at(objID).begin()->first) {
-      sharedObjects.push_back(obj);
+             objWrites.getThreaded(objID).front().tid != objReads.getThreaded(objID).front().tid) {
+      sharedObjects.push_back(objects[objID]);
     }
   }
   return sharedObjects;
 }
-size_t SharedMemory::numThreadsWrite(ObjID id) const {
-  auto it = objWrites.find(id);
-  if (it == objWrites.end()) return 0;
-  return it->second.size();
-}
-size_t SharedMemory::numThreadsRead(SharedMemory::ObjID id) const {
-  auto it = objReads.find(id);
-  if (it == objReads.end()) return 0;
-  return it->second.size();
-}
-std::map<ThreadID, std::vector<const ReadEvent *>> SharedMemory::getThreadedReads(const pta::ObjTy *obj) const {
-  auto id = objIDs.find(obj);
-  if (id == objIDs.end()) return {};
-
+llvm::ArrayRef<const MemAccessEvent *> SharedMemory::getCoalesced(const MemAccessEvent *event) const {
   // cppcheck-suppress stlIfFind
-  if (auto it = objReads.find(id->second); it != objReads.end()) {
+  if (auto it = coalesced.find(event); it != coalesced.end()) {
     return it->second;
   }
-
   return {};
 }
-std::map<ThreadID, std::vector<const WriteEvent *>> SharedMemory::getThreadedWrites(const pta::ObjTy *obj) const {
-  auto id = objIDs.find(obj);
-  if (id == objIDs.end()) return {};
 
-  // cppcheck-suppress stlIfFind
-  if (auto it = objWrites.find(id->second); it != objWrites.end()) {
-    return it->second;
+size_t SharedMemory::numCoalesced() const {
+  size_t total = 0;
+  for (auto const &[representative, accesses] : coalesced) {
+    total += accesses.size();
   }
+  return total;
+}
 
-  return {};
+size_t SharedMemory::numThreadsWrite(ObjID id) const { return objWrites.getThreaded(id).size(); }
+size_t SharedMemory::numThreadsRead(SharedMemory::ObjID id) const { return objReads.getThreaded(id).size(); }
+ThreadedIntervals<ReadEvent> SharedMemory::getThreadedReads(const pta::ObjTy *obj) const {
+  auto id = objIDs.find(obj);
+  if (id == objIDs.end()) return {};
+  return objReads.getThreaded(id->second);
+}
+ThreadedIntervals<WriteEvent> SharedMemory::getThreadedWrites(const pta::ObjTy *obj) const {
+  auto id = objIDs.find(obj);
+  if (id == objIDs.end()) return {};
+  return objWrites.getThreaded(id->second);
 }
@@ -11,6 +11,8 @@ limitations under the License.
 
 #pragma once
 
+#include <llvm/ADT/ArrayRef.h>
+
 #include <map>
 
 #include "LanguageModel/RaceModel.h"
@@ -18,30 +20,86 @@ limitations under the License.
 
 namespace race {
 
+// The accesses made by one thread between two adjacent sync (fork/join/barrier) or lock/unlock events.
+// Every access in an interval is ordered the same way by happens-before against events on other threads,
+// and holds the same set of locks, so both only need to be checked once per pair of intervals.
+// Accesses of shared call segments (see CallSegmentRef) belong to the interval of every call they are shared with.
+template <class EventT>
+struct SyncInterval {
+  // position of the interval on its thread
+  size_t id;
+  // never empty, ordered by event ID
+  llvm::ArrayRef<const EventT *> events;
+  // an event in the interval, used for happens-before and lockset queries on behalf of every access in it
+  // either one of the accesses, or the EnterCall event of a shared call whose accesses are in the interval
+  const Event *anchor;
+};
+
+// All accesses to one object from one thread
+template <class EventT>
+struct ThreadAccesses {
+  ThreadID tid;
+  // ordered by interval ID
+  llvm::ArrayRef<SyncInterval<EventT>> intervals;
+};
+
+// All accesses to one object, ordered by thread ID
+template <class EventT>
+using ThreadedIntervals = llvm::ArrayRef<ThreadAccesses<EventT>>;
+
+// Every access of one kind (read or write) to every object, in contiguous arrays.
+// Accesses are sorted by (object, thread, interval, event), and each level (object -> thread -> interval -> event)
+// is a range into the flat array of the level below, so no per-object containers are allocated.
+template <class EventT>
+struct AccessTable {
+  std::vector<const EventT *> events;
+  std::vector<SyncInterval<EventT>> intervals;
+  std::vector<ThreadAccesses<EventT>> threads;
+  // the threads accessing object i are threads[objOffsets[i], objOffsets[i+1])
+  std::vector<size_t> objOffsets;
+
+  [[nodiscard]] ThreadedIntervals<EventT> getThreaded(size_t objID) const {
+    return llvm::ArrayRef<ThreadAccesses<EventT>>(threads).slice(objOffsets.at(objID),
+                                                                  objOffsets.at(objID + 1) - objOffsets.at(objID));
+  }
+};
+
 struct SharedMemory {
   using ObjID = size_t;
-  std::map<const pta::ObjTy *, ObjID> objIDs;
 
-  struct Accesses {
-    std::vector<const ReadEvent *> reads;
-    std::vector<const WriteEvent *> writes;
-  };
+  // Dense IDs for every accessed object, assigned in order of pointer analysis object ID
+  // so that iterating over objects gives the same order on every run
+  std::vector<const pta::ObjTy *> objects;
+  std::map<const pta::ObjTy *, ObjID> objIDs;
 
-  std::map<ObjID, std::map<ThreadID, Accesses>> objAccesses;
+  AccessTable<ReadEvent> objReads;
+  AccessTable<WriteEvent> objWrites;
 
-  std::map<ObjID, std::map<ThreadID, std::vector<const ReadEvent *>>> objReads;
-  std::map<ObjID, std::map<ThreadID, std::vector<const WriteEvent *>>> objWrites;
+  // representative access -> the accesses merged into it
+  std::map<const MemAccessEvent *, std::vector<const MemAccessEvent *>> coalesced;
 
   [[nodiscard]] size_t numThreadsWrite(ObjID id) const;
   [[nodiscard]] size_t numThreadsRead(ObjID id) const;
 
  public:
-  explicit SharedMemory(const ProgramTrace &);
+  // If coalesce is set, repeated accesses are merged into one representative access, see getCoalesced
+  explicit SharedMemory(const ProgramTrace &, bool coalesce = true);
 
   [[nodiscard]] std::vector<const pta::ObjTy *> getSharedObjects() const;
 
-  // TODO: wrap this in option?? Make a copy?? Iterator??
-  [[nodiscard]] std::map<ThreadID, std::vector<const ReadEvent *>> getThreadedReads(const pta::ObjTy *obj) const;
-  [[nodiscard]] std::map<ThreadID, std::vector<const WriteEvent *>> getThreadedWrites(const pta::ObjTy *obj) const;
+  // Accesses to obj grouped by thread and then by sync interval
+  // The returned views are valid for the lifetime of this SharedMemory
+  [[nodiscard]] ThreadedIntervals<ReadEvent> getThreadedReads(const pta::ObjTy *obj) const;
+  [[nodiscard]] ThreadedIntervals<WriteEvent> getThreadedWrites(const pta::ObjTy *obj) const;
+
+  // Accesses of the same kind to the same value, in the same context and basic block, with the same alias scope
+  // metadata and no other events between them, are merged into the first one. They have the same points-to set,
+  // sync interval and lockset, and are treated the same by every race filter, so only the representative is stored
+  // in the access tables.
+  // Return the accesses merged into event, so a race found on event can be reported for each of them
+  [[nodiscard]] llvm::ArrayRef<const MemAccessEvent *> getCoalesced(const MemAccessEvent *event) const;
+
+  // Number of accesses merged into a representative and left out of the access tables
+  [[nodiscard]] size_t numCoalesced() const;
 };
-}  // namespace race
\ No newline at end of file
+}  // namespace race
@@ -11,6 +11,8 @@ limitations under the License.
 
 #include "Analysis/ThreadLocalAnalysis.h"
 
+#include "Trace/ProgramTrace.h"
+
 using namespace race;
 
 bool ThreadLocalAnalysis::isThreadLocalAccess(const MemAccessEvent *write, const MemAccessEvent *other) {
@@ -25,31 +27,8 @@ bool ThreadLocalAnalysis::isThreadLocalAccess(const MemAccessEvent *write, const
   // We should not report a race because the only possible
   // shared object is thread local.
 
-  const auto &writePtsTo = write->getAccessedMemory();
-  const auto &otherPtsTo = other->getAccessedMemory();
-
-  // this is set intersection, but we can fail fast unlike the stl implementation
-  // this allows us to have superior speeds in cases that definitely don't involve globals faster since it will just
-  // return false earlier
-  auto wptIter = writePtsTo.begin();
-  auto optIter = otherPtsTo.begin();
-  while (wptIter != writePtsTo.end() && optIter != otherPtsTo.end()) {
-    if (optIter == otherPtsTo.end() || *wptIter < *optIter) {
-      wptIter++;
-    } else if (wptIter == writePtsTo.end() || *wptIter > *optIter) {
-      optIter++;
-    } else {
-      auto const val = (*wptIter)->getValue();
-
-      auto const global = llvm::dyn_cast_or_null<llvm::GlobalVariable>(val);
-      if (!global || !global->isThreadLocal()) {
-        return false;
-      }
-      wptIter++;
-      optIter++;
-    }
-  }
-
-  // they were all threadlocal -- or none were shared, so in a sense they were thread local :)
-  return true;
+  // Points-to sets are interned with the objects that are not thread local as a bitset,
+  // so this is just a bitset intersection
+  auto const &pointsToSets = write->getThread().program.getPointsToSets();
+  return !pointsToSets.sharesNonThreadLocal(write->getPointsToSetID(), other->getPointsToSetID());
 }
@@ -0,0 +1,83 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "Analysis/ThreadMHP.h"
+
+using namespace race;
+
+ThreadMHP::ThreadMHP(const ProgramTrace &program, const HappensBeforeGraph &happensbefore) {
+  auto const &threads = program.getThreads();
+  for (auto const &thread : threads) {
+    numThreads = std::max(numThreads, thread->id + 1);
+  }
+  overlap.assign(numThreads * numThreads, false);
+
+  for (auto lit = threads.begin(), end = threads.end(); lit != end; ++lit) {
+    auto const &lhs = (*lit)->getEvents();
+    if (lhs.empty()) continue;
+
+    for (auto rit = std::next(lit); rit != end; ++rit) {
+      auto const &rhs = (*rit)->getEvents();
+      if (rhs.empty()) continue;
+
+      // If the last event of one thread happens before the first event of the other, no events can overlap
+      auto const ordered = happensbefore.canReach(lhs.back().get(), rhs.front().get()) ||
+                           happensbefore.canReach(rhs.back().get(), lhs.front().get());
+      if (!ordered) {
+        auto const l = (*lit)->id;
+        auto const r = (*rit)->id;
+        overlap.at(l * numThreads + r) = true;
+        overlap.at(r * numThreads + l) = true;
+      }
+    }
+  }
+}
+
+bool ThreadMHP::mayOverlap(ThreadID lhs, ThreadID rhs) const {
+  if (lhs >= numThreads || rhs >= numThreads) return false;
+  return overlap.at(lhs * numThreads + rhs);
+}
+
+std::vector<const pta::ObjTy *> ThreadMHP::pruneSharedObjects(const SharedMemory &sharedmem) {
+  std::vector<const pta::ObjTy *> kept;
+
+  for (auto const obj : sharedmem.getSharedObjects()) {
+    auto const threadedWrites = sharedmem.getThreadedWrites(obj);
+    auto const threadedReads = sharedmem.getThreadedReads(obj);
+
+    bool mayRace = false;
+    auto const checkPair = [&](ThreadID wtid, ThreadID otid) {
+      if (mayOverlap(wtid, otid)) {
+        mayRace = true;
+      } else {
+        ++numPrunedPairs;
+      }
+    };
+
+    for (auto it = threadedWrites.begin(), end = threadedWrites.end(); it != end; ++it) {
+      for (auto const &reads : threadedReads) {
+        if (it->tid == reads.tid) continue;
+        checkPair(it->tid, reads.tid);
+      }
+      for (auto wit = std::next(it); wit != end; ++wit) {
+        checkPair(it->tid, wit->tid);
+      }
+    }
+
+    if (mayRace) {
+      kept.push_back(obj);
+    } else {
+      ++numPrunedObjects;
+    }
+  }
+
+  return kept;
+}
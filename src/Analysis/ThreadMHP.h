@@ -0,0 +1,47 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include "Analysis/HappensBeforeGraph.h"
+#include "Analysis/SharedMemory.h"
+#include "Trace/ProgramTrace.h"
+
+namespace race {
+
+// Coarse thread level may-happen-in-parallel analysis
+// Two threads may overlap unless every event on one is guaranteed to happen before every event on the other,
+// e.g. a thread that is joined before the next thread is forked.
+// Used as a cheap prefilter before any per-event happens-before queries.
+class ThreadMHP {
+  size_t numThreads = 0;
+  // numThreads x numThreads matrix, indexed by thread ID
+  std::vector<bool> overlap;
+
+  // Number of shared objects and thread pairs removed by pruneSharedObjects
+  size_t numPrunedObjects = 0;
+  size_t numPrunedPairs = 0;
+
+ public:
+  ThreadMHP(const ProgramTrace &program, const HappensBeforeGraph &happensbefore);
+
+  // return true if any event on thread lhs may run in parallel with any event on thread rhs
+  [[nodiscard]] bool mayOverlap(ThreadID lhs, ThreadID rhs) const;
+
+  // Get the shared objects that have at least one write/read or write/write pair of accesses from threads that may
+  // overlap. Counts the objects and thread pairs that were dropped.
+  [[nodiscard]] std::vector<const pta::ObjTy *> pruneSharedObjects(const SharedMemory &sharedmem);
+
+  [[nodiscard]] size_t getNumPrunedObjects() const { return numPrunedObjects; }
+  [[nodiscard]] size_t getNumPrunedPairs() const { return numPrunedPairs; }
+};
+
+}  // namespace race
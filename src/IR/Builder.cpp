@@ -39,6 +39,12 @@ bool hasThreadLocalOperand(const llvm::Instruction *inst) {
   return false;
 }
 
+// return true if the operand of inst must point to an object no other thread can access
+bool hasThreadPrivateOperand(const llvm::Instruction *inst, const EscapeAnalysis *escape) {
+  if (!escape) return false;
+  return escape->isThreadPrivateAccess(getPointerOperand(inst));
+}
+
 // Get the next inst if it is call, else return nullptr
 const llvm::CallBase *getNextCall(const llvm::CallBase *call) {
   auto const next = call->getNextNode();
@@ -69,7 +75,8 @@ std::shared_ptr<OpenMPForkTeams> getTwinOmpForkTeams(std::shared_ptr<OpenMPForkT
 // TODO: need different system for storing and organizing these "recognizers"
 bool isPrintf(const llvm::StringRef &funcName) { return funcName.equals("printf"); }
 
-std::shared_ptr<const FunctionSummary> generateFunctionSummary(const llvm::Function &func) {
+std::shared_ptr<const FunctionSummary> generateFunctionSummary(const llvm::Function &func,
+                                                               const EscapeAnalysis *escape) {
   FunctionSummary summary;
 
   for (auto const &basicblock : func.getBasicBlockList()) {
@@ -83,12 +90,14 @@ std::shared_ptr<const FunctionSummary> generateFunctionSummary(const llvm::Funct
 
       // TODO: try switch on inst->getOpCode instead
       if (auto loadInst = llvm::dyn_cast<llvm::LoadInst>(inst)) {
-        if (loadInst->isAtomic() || loadInst->isVolatile() || hasThreadLocalOperand(loadInst)) {
+        if (loadInst->isAtomic() || loadInst->isVolatile() || hasThreadLocalOperand(loadInst) ||
+            hasThreadPrivateOperand(loadInst, escape)) {
           continue;
         }
         summary.push_back(std::make_shared<race::Load>(loadInst));
       } else if (auto storeInst = llvm::dyn_cast<llvm::StoreInst>(inst)) {
-        if (storeInst->isAtomic() || storeInst->isVolatile() || hasThreadLocalOperand(storeInst)) {
+        if (storeInst->isAtomic() || storeInst->isVolatile() || hasThreadLocalOperand(storeInst) ||
+            hasThreadPrivateOperand(storeInst, escape)) {
           continue;
         }
         summary.push_back(std::make_shared<race::Store>(storeInst));
@@ -240,7 +249,7 @@ std::shared_ptr<const FunctionSummary> FunctionSummaryBuilder::getFunctionSummar
   }
 
   // Else compute the summary and add to cache
-  auto const summary = generateFunctionSummary(*func);
+  auto const summary = generateFunctionSummary(*func, escape);
   cache.insert(std::make_pair(func, summary));
   return summary;
 }
@@ -16,6 +16,7 @@ limitations under the License.
 #include <set>
 #include <vector>
 
+#include "Analysis/EscapeAnalysis.h"
 #include "IR/IR.h"
 #include "IRImpls.h"
 
@@ -26,8 +27,12 @@ using FunctionSummary = std::vector<std::shared_ptr<const IR>>;
 // cache FunctionSummary here
 class FunctionSummaryBuilder {
   std::map<const llvm::Function *, std::shared_ptr<const FunctionSummary>> cache;
+  // If set, loads/stores of thread private objects are left out of summaries
+  const EscapeAnalysis *escape;
 
  public:
+  explicit FunctionSummaryBuilder(const EscapeAnalysis *escape = nullptr) : escape(escape) {}
+
   std::shared_ptr<const FunctionSummary> getFunctionSummary(const llvm::Function *func);
 };
 }  // namespace race
\ No newline at end of file
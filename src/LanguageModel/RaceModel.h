@@ -17,6 +17,7 @@ limitations under the License.
 #include "PointerAnalysis/Models/MemoryModel/CppMemModel/CppMemModel.h"
 #include "PointerAnalysis/Models/MemoryModel/DefaultHeapModel.h"
 #include "PointerAnalysis/Solver/PartialUpdateSolver.h"
+#include "PointerAnalysis/Solver/PointsTo/HashConsedPTS.h"
 
 namespace pta {
 using originCtx = KOrigin<3>;
@@ -25,7 +26,12 @@ using MemModel = cpp::CppMemModel<ctx>;
 using CallGraphNodeTy = CallGraphNode<ctx>;
 using CT = CtxTrait<ctx>;
 using GT = llvm::GraphTraits<const CallGraph<ctx>>;
+#ifdef HASH_CONSED_PTS
+// nodes with identical points-to sets share a single copy
+using PtsTy = HashConsedPTS;
+#else
 using PtsTy = BitVectorPTS;
+#endif
 
 class RaceModel : public LangModelBase<ctx, MemModel, PtsTy, RaceModel> {
  private:
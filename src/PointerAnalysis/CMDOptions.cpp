@@ -23,6 +23,9 @@ cl::opt<bool> USE_MEMLAYOUT_FILTERING(
     "Xmemlayout-filtering", cl::desc("Use memory layout to filter out incompatible types in field-sensitive PTA"));
 cl::opt<bool> CONFIG_VTABLE_MODE("Xenable-vtable", cl::desc("model vtable specially"), cl::init(false));
 cl::opt<bool> CONFIG_USE_FI_MODE("Xuse-fi-model", cl::desc("use field insensitive analyse"), cl::init(false));
+cl::opt<bool> CONFIG_OFFLINE_REDUCTION(
+    "Xoffline-reduction", cl::desc("merge pointers with provably identical points-to sets before solving"),
+    cl::init(true));
 
 // pta cmd options: set to default values
 cl::opt<bool> DEBUG_PTA("DEBUG_PTA", cl::desc("debug pointer analysis"), cl::init(false));
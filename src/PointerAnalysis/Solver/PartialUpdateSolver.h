@@ -11,14 +11,15 @@ limitations under the License.
 
 #pragma once
 
+#include <llvm/ADT/DenseSet.h>
+
+#include <atomic>
 #include <stack>
+#include <thread>
 
 #include "PointerAnalysis/Graph/ConstraintGraph/SCCIterator.h"
 #include "SolverBase.h"
 
-//#define HASH_EDGE_LIMIT 6700417 // a large enough prime number
-#define HASH_EDGE_LIMIT 1000032953
-
 namespace pta {
 // just experimental feature for now.
 // after resolving the indirect call, do not traverse the whole
@@ -105,11 +106,11 @@ class PartialUpdateSolver : public SolverBase<LangModel, PartialUpdateSolver<Lan
     }
 
     // we need to handle the copy edge
-    requiredEdge.set(hashEdge(src, dst));
+    requiredEdge.insert(std::make_pair(src, dst));
   }
 
-  // seems like the scc becomes the bottleneck, need to merge large scc
-  void processCopySCC(const std::vector<CGNodeTy *> &scc) {
+  // Merge the points-to sets of the nodes in scc into its front node and collapse them into it
+  CGNodeTy *collapseCopySCC(const std::vector<CGNodeTy *> &scc) {
     assert(scc.size() > 1);
 
     CGNodeTy *superNode = scc.front();
@@ -126,8 +127,8 @@ class PartialUpdateSolver : public SolverBase<LangModel, PartialUpdateSolver<Lan
     }
 
     lsWorkList.reset(superNode->getNodeID());
-
-    // changedCopy.set(hashEdge(superNode, superNode));
+    // the edges moved to the super node have not seen its pts yet, so the whole pts needs to be propagated
+    PT::resetDiff(superNode->getNodeID());
 
     // collapse scc to the front node
     super::getConsGraph()->collapseSCCTo(scc, superNode);
@@ -137,11 +138,15 @@ class PartialUpdateSolver : public SolverBase<LangModel, PartialUpdateSolver<Lan
       this->updateFunPtr(superNode->getNodeID());
     }
 
+    return superNode;
+  }
+
+  // seems like the scc becomes the bottleneck, need to merge large scc
+  void processCopySCC(const std::vector<CGNodeTy *> &scc) {
+    auto const superNode = collapseCopySCC(scc);
     for (auto cit = superNode->succ_copy_begin(), cie = superNode->succ_copy_end(); cit != cie; cit++) {
       if (super::processCopy(superNode, *cit)) {
         // the copy edge changed the pts of src
-        // changedCopy.set(hashEdge(superNode, *cit));
-
         lsWorkList.reset((*cit)->getNodeID());
       }
     }
@@ -154,20 +159,32 @@ class PartialUpdateSolver : public SolverBase<LangModel, PartialUpdateSolver<Lan
   // the target node id of the newly added copy edge by load/store/offset
   llvm::BitVector targetList;
 
-  // set of the new added copy edge (identified by the hash value of src/dst)
-  llvm::BitVector requiredEdge;
+  // set of the new added copy edge (src, dst)
+  // only holds the edges recorded since the last iteration, so it stays small and is cheap to clear
+  llvm::DenseSet<std::pair<CGNodeTy *, CGNodeTy *>> requiredEdge;
 
   // llvm::BitVector changedCopy;
 
+  // number of threads used to propagate copy edges, see propagateCopiesInParallel
+  unsigned int numWorkers = 1;
+
+  // levels with fewer nodes than this are propagated on the calling thread
+  size_t minParallelLevelSize = 256;
+
  public:
-  PartialUpdateSolver() : copyWorkList(), lsWorkList(), targetList(), requiredEdge(HASH_EDGE_LIMIT) {}
+  PartialUpdateSolver() : copyWorkList(), lsWorkList(), targetList(), requiredEdge() {}
 
- protected:
-  inline size_t hashEdge(CGNodeTy *src, CGNodeTy *dst) {
-    size_t hashed = llvm::hash_value(std::make_pair<void *, void *>(src, dst));
-    return hashed % HASH_EDGE_LIMIT;
+  // Copy edges are propagated on up to workers threads (0 uses all cores)
+  // The points-to sets computed do not depend on the number of workers
+  void setNumWorkers(unsigned int workers) {
+    numWorkers = workers == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : workers;
   }
 
+  // Levels of the copy graph with fewer than size nodes are propagated on the calling thread, as starting the workers
+  // costs more than it saves. Mostly useful to run small programs on multiple workers in tests
+  void setMinParallelLevelSize(size_t size) { minParallelLevelSize = size; }
+
+ protected:
   bool shouldProcessCopy(CGNodeTy *src, CGNodeTy *dst) {
     if (!lsWorkList.test(src->getNodeID())) {
       // if the incoming src changed then yes
@@ -178,12 +195,123 @@ class PartialUpdateSolver : public SolverBase<LangModel, PartialUpdateSolver<Lan
 
     if (isDstTarget && isSrcUnhandled) {
       // whether this is the edge
-      return requiredEdge.test(hashEdge(src, dst));
+      return requiredEdge.count(std::make_pair(src, dst)) > 0;
     }
 
     return false;
   }
 
+  // Propagate the copy edge src -> dst that should be processed.
+  // If the edge is not newly added, dst already has everything src pointed to when src was last handled by
+  // load/store, so only the difference since then is copied.
+  bool propagateCopy(CGNodeTy *src, CGNodeTy *dst) {
+    if (requiredEdge.count(std::make_pair(src, dst)) > 0) {
+      return super::processCopy(src, dst);
+    }
+    return super::processDiffCopy(src, dst);
+  }
+
+  // Propagate copy edges in the SCCs on copySCCStack on up to numWorkers threads.
+  // Every SCC is collapsed first, then each node is given a level one deeper than its deepest predecessor, so nodes
+  // on the same level never copy into each other. Levels are propagated in order, and each node of a level pulls from
+  // its predecessors, so a worker only writes to the points-to sets of its own nodes and every edge is decided by
+  // shouldProcessCopy exactly as in the sequential traversal.
+  void propagateCopiesInParallel(std::stack<std::vector<CGNodeTy *>> &copySCCStack) {
+    // nodes in topological order, with each SCC collapsed into its front node
+    std::vector<CGNodeTy *> order;
+    bool collapsed = false;
+    while (!copySCCStack.empty()) {
+      auto const &scc = copySCCStack.top();
+      if (scc.size() > 1) {
+        collapseCopySCC(scc);
+        collapsed = true;
+      }
+      order.push_back(scc.front());
+      copySCCStack.pop();
+    }
+
+    // copy edges required into or out of a collapsed node are now edges of its super node
+    if (collapsed) {
+      std::vector<std::pair<CGNodeTy *, CGNodeTy *>> remapped;
+      for (auto const &[src, dst] : requiredEdge) {
+        if (src->hasSuperNode() || dst->hasSuperNode()) {
+          remapped.emplace_back(src->getSuperNode(), dst->getSuperNode());
+        }
+      }
+      requiredEdge.insert(remapped.begin(), remapped.end());
+    }
+
+    // only edges from nodes visited by the SCC traversal are propagated
+    llvm::DenseMap<const CGNodeTy *, size_t> levelOf;
+    std::vector<std::vector<CGNodeTy *>> levels;
+    for (auto const node : order) {
+      size_t level = 0;
+      for (auto it = node->pred_copy_begin(), ie = node->pred_copy_end(); it != ie; it++) {
+        // cppcheck-suppress stlIfFind
+        if (auto pred = levelOf.find(*it); pred != levelOf.end()) {
+          level = std::max(level, pred->second + 1);
+        }
+      }
+      levelOf[node] = level;
+      if (level == levels.size()) {
+        levels.emplace_back();
+      }
+      levels[level].push_back(node);
+    }
+
+    // Pull the points-to sets of the visited predecessors of node, return true if it changed
+    auto const pullCopies = [&](CGNodeTy *node) {
+      bool changed = false;
+      for (auto it = node->pred_copy_begin(), ie = node->pred_copy_end(); it != ie; it++) {
+        CGNodeTy *pred = *it;
+        if (pred == node || levelOf.count(pred) == 0 || !shouldProcessCopy(pred, node)) continue;
+        if (requiredEdge.count(std::make_pair(pred, node)) > 0) {
+          changed |= PT::unionWith(node->getNodeID(), pred->getNodeID());
+        } else {
+          changed |= PT::unionWithDiff(node->getNodeID(), pred->getNodeID());
+        }
+      }
+      return changed;
+    };
+
+    // worklists and the function pointer set are only updated once a level is done
+    std::vector<std::vector<CGNodeTy *>> changedNodes(numWorkers);
+    for (auto const &level : levels) {
+      auto const numLevelWorkers = level.size() < minParallelLevelSize ? 1 : numWorkers;
+      std::atomic<size_t> next = 0;
+      auto const worker = [&](std::vector<CGNodeTy *> &changed) {
+        for (auto i = next++; i < level.size(); i = next++) {
+          if (pullCopies(level[i])) {
+            changed.push_back(level[i]);
+          }
+        }
+      };
+
+      if (numLevelWorkers == 1) {
+        worker(changedNodes.front());
+      } else {
+        std::vector<std::thread> workers;
+        workers.reserve(numLevelWorkers);
+        for (unsigned int i = 0; i < numLevelWorkers; ++i) {
+          workers.emplace_back(worker, std::ref(changedNodes[i]));
+        }
+        for (auto &thread : workers) {
+          thread.join();
+        }
+      }
+
+      for (auto &changed : changedNodes) {
+        for (auto const node : changed) {
+          lsWorkList.reset(node->getNodeID());
+          if (node->isFunctionPtr()) {
+            this->updateFunPtr(node->getNodeID());
+          }
+        }
+        changed.clear();
+      }
+    }
+  }
+
   int numOfPTAIterations = 0;
   void runSolver(LangModel & /* langModel */) {
     ConsGraphTy &consGraph = *(super::getConsGraph());
@@ -200,6 +328,11 @@ class PartialUpdateSolver : public SolverBase<LangModel, PartialUpdateSolver<Lan
         copySCCStack.push(*copy_it);
       }
 
+      // the parallel propagation empties copySCCStack
+      if (numWorkers > 1) {
+        propagateCopiesInParallel(copySCCStack);
+      }
+
       while (!copySCCStack.empty()) {
         const std::vector<CGNodeTy *> &scc = copySCCStack.top();
         // llvm::outs() << scc.front()->getNodeID() << ",";
@@ -210,8 +343,7 @@ class PartialUpdateSolver : public SolverBase<LangModel, PartialUpdateSolver<Lan
           CGNodeTy *curNode = scc.front();
           for (auto cit = curNode->succ_copy_begin(), cie = curNode->succ_copy_end(); cit != cie; cit++) {
             if (shouldProcessCopy(curNode, *cit)) {
-              if (super::processCopy(curNode, *cit)) {
-                // changedCopy.set(hashEdge(curNode, *cit));
+              if (propagateCopy(curNode, *cit)) {
                 lsWorkList.reset((*cit)->getNodeID());
               }
             }
@@ -226,7 +358,7 @@ class PartialUpdateSolver : public SolverBase<LangModel, PartialUpdateSolver<Lan
       copyWorkList.set();  // empty the worklist
       targetList.set();
 
-      requiredEdge.reset();
+      requiredEdge.clear();
 
       // const size_t prevNodeNum = consGraph.getNodeNum();
       int _lastID = lsWorkList.find_first_unset();
@@ -235,12 +367,15 @@ class PartialUpdateSolver : public SolverBase<LangModel, PartialUpdateSolver<Lan
 
         CGNodeTy *curNode = consGraph.getNode(lastID);
 
+        // the objects pointed to before curNode was last handled already have their copy edges
         for (auto it = curNode->pred_store_begin(), ie = curNode->pred_store_end(); it != ie; it++) {
-          super::processStore(*it, curNode, [&](CGNodeTy *src, CGNodeTy *dst) { recordCopyEdge(src, dst); });
+          super::processStore(
+              *it, curNode, [&](CGNodeTy *src, CGNodeTy *dst) { recordCopyEdge(src, dst); }, true);
         }
 
         for (auto it = curNode->succ_load_begin(), ie = curNode->succ_load_end(); it != ie; it++) {
-          super::processLoad(curNode, *it, [&](CGNodeTy *src, CGNodeTy *dst) { recordCopyEdge(src, dst); });
+          super::processLoad(
+              curNode, *it, [&](CGNodeTy *src, CGNodeTy *dst) { recordCopyEdge(src, dst); }, true);
         }
 
         // to handled special constraints
@@ -256,6 +391,8 @@ class PartialUpdateSolver : public SolverBase<LangModel, PartialUpdateSolver<Lan
           });
         }
 #endif
+        // every successor has seen the pts of curNode by now
+        PT::clearDiff(lastID);
         _lastID = lsWorkList.find_next_unset(lastID);
       }
 
@@ -310,11 +447,6 @@ class PartialUpdateSolver : public SolverBase<LangModel, PartialUpdateSolver<Lan
       targetList.resize(super::getConsGraph()->getNodeNum(), false);
       copyWorkList.resize(super::getConsGraph()->getNodeNum(), false);
 #endif
-      // The call to count in this log message is evaluated regardless of log
-      // level and are very expensive LOG_TRACE("hash map fill rate, count = {},
-      // size = {}, rate={}", requiredEdge.count(), requiredEdge.size(),
-      //           ((float)requiredEdge.count()) / requiredEdge.size());
-
       LOG_DEBUG("PTA Iteration No: {} - nodes: {}", numOfPTAIterations++, this->getConsGraph()->getNodeNum());
     } while (!copyWorkList.all());
   }
@@ -338,7 +470,7 @@ class PartialUpdateSolver : public SolverBase<LangModel, PartialUpdateSolver<Lan
       assert(lsWorkList.all());  // all visited (1)
       assert(targetList.all());
       assert(copyWorkList.all());
-      assert(!requiredEdge.any());  // all zero
+      assert(requiredEdge.empty());
 
       // record every constraints added during indirect call resolve
       size_t prevNodeNum = super::getConsGraph()->getNodeNum();
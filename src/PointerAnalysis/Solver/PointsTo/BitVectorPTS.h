@@ -29,16 +29,44 @@ class BitVectorPTS {
   static std::vector<PtsTy> ptsVec;
   // ptsVec[20] ==> SparseBitVector ==> "010000..."
 
+  // the objects added to ptsVec[id] since the solver last called clearDiff(id)
+  // it is cleared once the solver handled them, so it only holds the recent additions
+  static std::vector<PtsTy> diffVec;
+
   static inline void onNewNodeCreation(NodeID id) {
     // should be the same value
     // int ** ptr = (int **) malloc(sizeof(int *)); // o1
     // *ptr = &o2; // ptr
     assert(id == ptsVec.size());
     ptsVec.emplace_back();
-    assert(ptsVec.size() == (id + 1));
+    diffVec.emplace_back();
+    assert(ptsVec.size() == (id + 1) && diffVec.size() == (id + 1));
+  }
+
+  static inline void clearAll() {
+    ptsVec.clear();
+    diffVec.clear();
   }
 
-  static inline void clearAll() { ptsVec.clear(); }
+  // pts(src) |= other, the newly added objects are recorded in the diff of src
+  static inline bool unionWithSet(NodeID src, const PtsTy& other) {
+    PtsTy added;
+    added.intersectWithComplement(other, ptsVec[src]);
+    if (added.empty()) {
+      return false;
+    }
+
+    ptsVec[src] |= added;
+    diffVec[src] |= added;
+    // bz: this has no problem, but compiler won't git up warnings ... so translate equivalently
+    // assert(ptsVec[src].find_last() < 0 ? true : ptsVec[src].find_last() < ptsVec.size());
+    int _last = ptsVec[src].find_last();
+    if (_last >= 0) {
+      long unsigned int last = static_cast<long unsigned int>(_last);
+      assert(last < ptsVec.size());
+    }
+    return true;
+  }
 
   // get the pts of the corresponding node
   [[nodiscard]] static inline const PtsTy& getPointsTo(NodeID id) {
@@ -49,16 +77,30 @@ class BitVectorPTS {
   // union the pts of the nodes
   static inline bool unionWith(NodeID src, NodeID dst) {
     assert(src < ptsVec.size() && dst < ptsVec.size());
+    return unionWithSet(src, ptsVec[dst]);
+  }
 
-    bool r = ptsVec[src] |= ptsVec[dst];
-    // bz: this has no problem, but compiler won't git up warnings ... so translate equivalently
-    // assert(ptsVec[src].find_last() < 0 ? true : ptsVec[src].find_last() < ptsVec.size());
-    int _last = ptsVec[src].find_last();
-    if (_last >= 0) {
-      long unsigned int last = static_cast<long unsigned int>(_last);
-      assert(last < ptsVec.size());
-    }
-    return r;
+  // union only the objects recently added to the pts of dst
+  static inline bool unionWithDiff(NodeID src, NodeID dst) {
+    assert(src < ptsVec.size() && dst < ptsVec.size());
+    return unionWithSet(src, diffVec[dst]);
+  }
+
+  // get the objects added to the pts of the node since the last clearDiff
+  [[nodiscard]] static inline const PtsTy& getDiffPointsTo(NodeID id) {
+    assert(id < diffVec.size());
+    return diffVec[id];
+  }
+
+  static inline void clearDiff(NodeID id) {
+    assert(id < diffVec.size());
+    diffVec[id].clear();
+  }
+
+  // treat the whole pts of the node as newly added
+  static inline void resetDiff(NodeID id) {
+    assert(id < diffVec.size());
+    diffVec[id] = ptsVec[id];
   }
 
   // whether the two pts intersect
@@ -84,7 +126,11 @@ class BitVectorPTS {
     assert(src < ptsVec.size() && idx < ptsVec.size());
 
     // JEFF TODO: check if they have the same type?
-    return ptsVec[src].test_and_set(idx);
+    if (ptsVec[src].test_and_set(idx)) {
+      diffVec[src].set(idx);
+      return true;
+    }
+    return false;
   }
 
   // Return true if this has idx as an element
@@ -123,6 +169,7 @@ class BitVectorPTS {
   static inline void clear(NodeID id) {
     assert(id < ptsVec.size());
     ptsVec[id].clear();
+    diffVec[id].clear();
   }
 
   static inline size_t count(NodeID id) {
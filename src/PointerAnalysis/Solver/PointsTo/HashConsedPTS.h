@@ -0,0 +1,350 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// the pts data structure that shares identical points-to sets between nodes
+#pragma once
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Hashing.h>
+#include <llvm/ADT/SparseBitVector.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "PointerAnalysis/Solver/PointsTo/PTSTrait.h"
+
+namespace pta {
+
+// Every distinct points-to set is stored once in a pool and never modified afterwards, each node only refers to the
+// pooled set it points to. insert and unionWith build the new set and look it up in the pool (copy-on-write), the
+// result of the union of two pooled sets is cached, so that repeating a union is a single lookup.
+// As the sets are unique, two nodes have equal points-to sets iff they refer to the same pooled set.
+//
+// Pooled sets are reference counted by the nodes and union cache entries that refer to them, and freed once there are
+// none, so the sets a node passes through while it grows do not stay in the pool. The union cache is cleared when it
+// reaches MAX_UNION_CACHE_SIZE entries. The diff of each node is only ever read by the solver, so it is a plain set
+// owned by the node rather than a pooled one.
+// The hash of a set is the sum of the hashes of its elements, so the hash of a grown set is computed from the objects
+// added to it alone instead of rehashing the whole set.
+class HashConsedPTS {
+ private:
+  using TargetID = NodeID;
+  using PtsTy = llvm::SparseBitVector<>;
+  using iterator = PtsTy::iterator;
+
+  struct PooledSet {
+    PtsTy set;
+    size_t hash;
+    // number of nodes and union cache entries referring to the set
+    size_t refs;
+  };
+  using SetRef = PooledSet *;
+  using SetPair = std::pair<SetRef, SetRef>;
+
+  static constexpr size_t MAX_UNION_CACHE_SIZE = 1 << 16;
+
+  // the pooled set each node points to, each holds a reference
+  static std::vector<SetRef> ptsVec;
+  // the objects added to the pts of each node since the solver last called clearDiff
+  static std::vector<PtsTy> diffVec;
+
+  // owns every distinct set, by the hash of its elements
+  static std::unordered_multimap<size_t, std::unique_ptr<PooledSet>> pool;
+  // (a, b) ==> a | b, a is the smaller pointer as the union is commutative
+  // every entry holds a reference to a, b and the result, so cached sets cannot be freed and reused
+  static llvm::DenseMap<SetPair, SetRef> unionCache;
+  // guards the pool, the reference counts and the cache, the copy edges are propagated on multiple threads
+  static std::mutex poolMutex;
+  // never freed before clearAll
+  static SetRef emptySet;
+
+  [[nodiscard]] static inline size_t hashElement(TargetID id) { return llvm::hash_value(id); }
+
+  [[nodiscard]] static inline size_t hashSet(const PtsTy &set) {
+    size_t hash = 0;
+    for (auto id : set) {
+      hash += hashElement(id);
+    }
+    return hash;
+  }
+
+  // return a new reference to the pooled set equal to set, add set to the pool if there is none
+  // poolMutex must be held
+  static inline SetRef acquire(PtsTy &&set, size_t hash) {
+    auto range = pool.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second->set == set) {
+        it->second->refs++;
+        return it->second.get();
+      }
+    }
+
+    auto it = pool.emplace(hash, std::make_unique<PooledSet>(PooledSet{std::move(set), hash, 1}));
+    return it->second.get();
+  }
+
+  // drop a reference to set and free it if it was the last one, poolMutex must be held
+  static inline void release(SetRef set) {
+    assert(set->refs > 0);
+    if (--set->refs > 0) {
+      return;
+    }
+
+    auto range = pool.equal_range(set->hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second.get() == set) {
+        pool.erase(it);
+        return;
+      }
+    }
+  }
+
+  // drop every cached union and the references they hold, poolMutex must be held
+  static inline void clearUnionCache() {
+    for (auto const &entry : unionCache) {
+      release(entry.first.first);
+      release(entry.first.second);
+      release(entry.second);
+    }
+    unionCache.clear();
+  }
+
+  // return a new reference to the already pooled set
+  static inline SetRef share(SetRef set) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    set->refs++;
+    return set;
+  }
+
+  // return a new reference to the pooled set equal to base | added, added must not intersect base
+  static inline SetRef grow(SetRef base, const PtsTy &added) {
+    PtsTy result = base->set;
+    result |= added;
+    size_t hash = base->hash + hashSet(added);
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return acquire(std::move(result), hash);
+  }
+
+  // return a new reference to a | b, added is set to the objects of b that are not in a
+  static inline SetRef unionSets(SetRef a, SetRef b, PtsTy &added) {
+    added.intersectWithComplement(b->set, a->set);
+    SetPair key = std::less<SetRef>()(a, b) ? std::make_pair(a, b) : std::make_pair(b, a);
+    {
+      std::lock_guard<std::mutex> lock(poolMutex);
+      auto it = unionCache.find(key);
+      if (it != unionCache.end()) {
+        it->second->refs++;
+        return it->second;
+      }
+    }
+
+    SetRef pooled = grow(a, added);
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (unionCache.size() >= MAX_UNION_CACHE_SIZE) {
+      clearUnionCache();
+    }
+    if (unionCache.try_emplace(key, pooled).second) {
+      a->refs++;
+      b->refs++;
+      pooled->refs++;
+    }
+    return pooled;
+  }
+
+  // make src point to set, which is its current pts | added, taking over the reference to set
+  // the newly added objects are recorded in the diff of src
+  static inline bool assign(NodeID src, SetRef set, const PtsTy &added) {
+    SetRef oldSet = ptsVec[src];
+    if (set != oldSet) {
+      diffVec[src] |= added;
+      ptsVec[src] = set;
+    }
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    release(oldSet);
+    return set != oldSet;
+  }
+
+  static inline void onNewNodeCreation(NodeID id) {
+    assert(id == ptsVec.size());
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (emptySet == nullptr) {
+      // the extra reference keeps the empty set alive while no node points to it
+      emptySet = acquire(PtsTy(), 0);
+    }
+
+    emptySet->refs++;
+    ptsVec.push_back(emptySet);
+    diffVec.emplace_back();
+    assert(ptsVec.size() == (id + 1) && diffVec.size() == (id + 1));
+  }
+
+  static inline void clearAll() {
+    ptsVec.clear();
+    diffVec.clear();
+    unionCache.clear();
+    pool.clear();
+    emptySet = nullptr;
+  }
+
+  // get the pts of the corresponding node
+  [[nodiscard]] static inline const PtsTy &getPointsTo(NodeID id) {
+    assert(id < ptsVec.size());
+    return ptsVec[id]->set;
+  }
+
+  // union the pts of the nodes
+  static inline bool unionWith(NodeID src, NodeID dst) {
+    assert(src < ptsVec.size() && dst < ptsVec.size());
+    SetRef other = ptsVec[dst];
+    if (other == ptsVec[src] || other == emptySet) {
+      return false;
+    }
+    if (ptsVec[src] == emptySet) {
+      return assign(src, share(other), other->set);
+    }
+
+    PtsTy added;
+    SetRef result = unionSets(ptsVec[src], other, added);
+    return assign(src, result, added);
+  }
+
+  // union only the objects recently added to the pts of dst
+  static inline bool unionWithDiff(NodeID src, NodeID dst) {
+    assert(src < ptsVec.size() && dst < ptsVec.size());
+    if (ptsVec[src] == ptsVec[dst]) {
+      // the diff of dst is a subset of its pts
+      return false;
+    }
+
+    PtsTy added;
+    added.intersectWithComplement(diffVec[dst], ptsVec[src]->set);
+    if (added.empty()) {
+      return false;
+    }
+    return assign(src, grow(ptsVec[src], added), added);
+  }
+
+  // get the objects added to the pts of the node since the last clearDiff
+  [[nodiscard]] static inline const PtsTy &getDiffPointsTo(NodeID id) {
+    assert(id < diffVec.size());
+    return diffVec[id];
+  }
+
+  static inline void clearDiff(NodeID id) {
+    assert(id < diffVec.size());
+    diffVec[id].clear();
+  }
+
+  // treat the whole pts of the node as newly added
+  static inline void resetDiff(NodeID id) {
+    assert(id < diffVec.size());
+    diffVec[id] = ptsVec[id]->set;
+  }
+
+  // whether the two pts intersect
+  [[nodiscard]] static inline bool intersectWith(NodeID src, NodeID dst) {
+    assert(src < ptsVec.size() && dst < ptsVec.size());
+    return ptsVec[src]->set.intersects(ptsVec[dst]->set);
+  }
+
+  [[nodiscard]] static inline bool intersectWithNoSpecialNode(NodeID src, NodeID dst) {
+    assert(src < ptsVec.size() && dst < ptsVec.size());
+    auto result = ptsVec[src]->set & ptsVec[dst]->set;
+
+    for (unsigned i = 0; i < NORMAL_OBJ_START_ID; i++) {
+      // remove special node
+      result.reset(i);
+    }
+
+    return !result.empty();
+  }
+
+  // insert a node into the pts
+  static inline bool insert(NodeID src, TargetID idx) {
+    assert(src < ptsVec.size() && idx < ptsVec.size());
+    if (ptsVec[src]->set.test(idx)) {
+      return false;
+    }
+
+    PtsTy added;
+    added.set(idx);
+    return assign(src, grow(ptsVec[src], added), added);
+  }
+
+  // Return true if this has idx as an element
+  [[nodiscard]] static inline bool has(NodeID src, TargetID idx) {
+    assert(src < ptsVec.size() && idx < ptsVec.size());
+    return ptsVec[src]->set.test(idx);
+  }
+
+  [[nodiscard]] static inline bool equal(NodeID src, NodeID dst) {
+    assert(src < ptsVec.size() && dst < ptsVec.size());
+    // the pooled sets are unique
+    return ptsVec[src] == ptsVec[dst];
+  }
+
+  // Return true if *this is a superset of other
+  [[nodiscard]] static inline bool contains(NodeID src, NodeID dst) {
+    assert(src < ptsVec.size() && dst < ptsVec.size());
+    return ptsVec[src] == ptsVec[dst] || ptsVec[src]->set.contains(ptsVec[dst]->set);
+  }
+
+  [[nodiscard]] static inline bool isEmpty(NodeID id) {
+    assert(id < ptsVec.size());
+    return ptsVec[id] == emptySet;
+  }
+
+  [[nodiscard]] static inline iterator begin(NodeID id) {
+    assert(id < ptsVec.size());
+    return ptsVec[id]->set.begin();
+  }
+
+  [[nodiscard]] static inline iterator end(NodeID id) {
+    assert(id < ptsVec.size());
+    return ptsVec[id]->set.end();
+  }
+
+  static inline void clear(NodeID id) {
+    assert(id < ptsVec.size());
+    diffVec[id].clear();
+    if (ptsVec[id] == emptySet) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    release(ptsVec[id]);
+    emptySet->refs++;
+    ptsVec[id] = emptySet;
+  }
+
+  static inline size_t count(NodeID id) {
+    assert(id < ptsVec.size());
+    return ptsVec[id]->set.count();
+  }
+
+  static inline const PtsTy &getPointedBy(NodeID /*id*/) {
+    llvm_unreachable("not supported by HashConsedPTS, use PointedByPts instead");
+  }
+
+  static inline constexpr bool supportPointedBy() { return false; }
+
+  friend class PTSTrait<HashConsedPTS>;
+};
+
+}  // namespace pta
+
+DEFINE_PTS_TRAIT(pta::HashConsedPTS)
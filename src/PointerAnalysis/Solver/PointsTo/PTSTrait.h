@@ -32,6 +32,17 @@ struct PTSTrait {
 
   static inline bool unionWith(NodeID src, NodeID dst) { return Pts::unKnownMethodError(src, dst); }
 
+  // union only the objects added to the pts of dst since its last clearDiff
+  static inline bool unionWithDiff(NodeID src, NodeID dst) { return Pts::unKnownMethodError(src, dst); }
+
+  // the objects added to the pts since the last clearDiff
+  static inline const PtsTy& getDiffPointsTo(NodeID id) { return Pts::unKnownMethodError(id); }
+
+  static inline void clearDiff(NodeID id) { return Pts::unKnownMethodError(id); }
+
+  // make the whole pts the diff again
+  static inline void resetDiff(NodeID id) { return Pts::unKnownMethodError(id); }
+
   static inline bool intersectWith(NodeID src, NodeID dst) { return Pts::unKnownMethodError(src, dst); }
 
   static inline bool intersectWithNoSpecialNode(NodeID src, NodeID dst) { return Pts::unKnownMethodError(src, dst); }
@@ -74,6 +85,14 @@ struct PTSTrait {
                                                                                                        \
     static inline bool unionWith(NodeID src, NodeID dst) { return IMPL::unionWith(src, dst); }         \
                                                                                                        \
+    static inline bool unionWithDiff(NodeID src, NodeID dst) { return IMPL::unionWithDiff(src, dst); } \
+                                                                                                       \
+    static inline const PtsTy& getDiffPointsTo(NodeID id) { return IMPL::getDiffPointsTo(id); }        \
+                                                                                                       \
+    static inline void clearDiff(NodeID id) { return IMPL::clearDiff(id); }                            \
+                                                                                                       \
+    static inline void resetDiff(NodeID id) { return IMPL::resetDiff(id); }                            \
+                                                                                                       \
     static inline bool intersectWith(NodeID src, NodeID dst) { return IMPL::intersectWith(src, dst); } \
                                                                                                        \
     static inline bool intersectWithNoSpecialNode(NodeID src, NodeID dst) {                            \
@@ -27,10 +27,13 @@ class PointedByPts {
   static std::vector<PtsTy> pointsTo;
   // pointed by set
   static std::vector<PtsTy> pointedBy;
+  // the objects added to the points to set since the last clearDiff
+  static std::vector<PtsTy> diff;
 
   static void clearAll() {
     pointsTo.clear();
     pointedBy.clear();
+    diff.clear();
   }
 
   static inline void onNewNodeCreation(NodeID id) {
@@ -39,21 +42,56 @@ class PointedByPts {
 
     pointsTo.emplace_back();
     pointedBy.emplace_back();
+    diff.emplace_back();
 
-    assert(pointsTo.size() == id + 1 && pointedBy.size() == id + 1);
+    assert(pointsTo.size() == id + 1 && pointedBy.size() == id + 1 && diff.size() == id + 1);
   }
 
-  // union the pts of the nodes
-  static inline bool unionWith(NodeID src, NodeID dst) {
-    assert(src < pointsTo.size() && dst < pointsTo.size());
+  // pts(src) |= other, where other is a subset of pts(dst)
+  static inline bool unionWithSet(NodeID src, NodeID dst, const PtsTy& other) {
+    PtsTy added;
+    added.intersectWithComplement(other, pointsTo[src]);
+    if (added.empty()) {
+      return false;
+    }
+
     // update the pointed by relation first
-    for (NodeID id : pointsTo[dst]) {
+    for (NodeID id : added) {
       // must be pointed by dst already
       assert(pointedBy[id].test(dst));
       // now can also be pointed by src
       pointedBy[id].set(src);
     }
-    return pointsTo[src] |= pointsTo[dst];
+    pointsTo[src] |= added;
+    diff[src] |= added;
+    return true;
+  }
+
+  // union the pts of the nodes
+  static inline bool unionWith(NodeID src, NodeID dst) {
+    assert(src < pointsTo.size() && dst < pointsTo.size());
+    return unionWithSet(src, dst, pointsTo[dst]);
+  }
+
+  // union only the objects recently added to the pts of dst
+  static inline bool unionWithDiff(NodeID src, NodeID dst) {
+    assert(src < pointsTo.size() && dst < pointsTo.size());
+    return unionWithSet(src, dst, diff[dst]);
+  }
+
+  [[nodiscard]] static inline const PtsTy& getDiffPointsTo(NodeID id) {
+    assert(id < diff.size());
+    return diff[id];
+  }
+
+  static inline void clearDiff(NodeID id) {
+    assert(id < diff.size());
+    diff[id].clear();
+  }
+
+  static inline void resetDiff(NodeID id) {
+    assert(id < diff.size());
+    diff[id] = pointsTo[id];
   }
 
   // whether the two pts intersect
@@ -79,7 +117,11 @@ class PointedByPts {
     assert(src < pointsTo.size() && idx < pointsTo.size());
     // idx now can be pointed by src
     pointedBy[idx].set(src);
-    return pointsTo[src].test_and_set(idx);
+    if (pointsTo[src].test_and_set(idx)) {
+      diff[src].set(idx);
+      return true;
+    }
+    return false;
   }
 
   [[nodiscard]] static inline bool equal(NodeID src, NodeID dst) {
@@ -117,6 +159,7 @@ class PointedByPts {
   static inline void clear(NodeID id) {
     assert(id < pointsTo.size());
     pointsTo[id].clear();
+    diff[id].clear();
   }
 
   [[nodiscard]] static inline const PtsTy& getPointedBy(NodeID id) {
@@ -10,11 +10,21 @@ limitations under the License.
 ==============================================================================*/
 
 #include "PointerAnalysis/Solver/PointsTo/BitVectorPTS.h"
+#include "PointerAnalysis/Solver/PointsTo/HashConsedPTS.h"
 #include "PointerAnalysis/Solver/PointsTo/PointedByPts.h"
 
 namespace pta {
 std::vector<BitVectorPTS::PtsTy> BitVectorPTS::ptsVec;
+std::vector<BitVectorPTS::PtsTy> BitVectorPTS::diffVec;
+
+std::vector<HashConsedPTS::SetRef> HashConsedPTS::ptsVec;
+std::vector<HashConsedPTS::PtsTy> HashConsedPTS::diffVec;
+std::unordered_multimap<size_t, std::unique_ptr<HashConsedPTS::PooledSet>> HashConsedPTS::pool;
+llvm::DenseMap<HashConsedPTS::SetPair, HashConsedPTS::SetRef> HashConsedPTS::unionCache;
+std::mutex HashConsedPTS::poolMutex;
+HashConsedPTS::SetRef HashConsedPTS::emptySet = nullptr;
 
 std::vector<PointedByPts::PtsTy> PointedByPts::pointsTo;
 std::vector<PointedByPts::PtsTy> PointedByPts::pointedBy;
+std::vector<PointedByPts::PtsTy> PointedByPts::diff;
 }  // namespace pta
\ No newline at end of file
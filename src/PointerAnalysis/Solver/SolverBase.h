@@ -18,16 +18,22 @@ limitations under the License.
 #include <llvm/IR/Module.h>
 #include <llvm/Pass.h>
 
+#include <algorithm>
+#include <limits>
+#include <map>
+
 //#include "RDUtil.h"
 #include "Logging/Log.h"
 #include "PointerAnalysis/Graph/CallGraph.h"
 #include "PointerAnalysis/Graph/ConstraintGraph/ConstraintGraph.h"
+#include "PointerAnalysis/Graph/ConstraintGraph/SCCIterator.h"
 #include "PointerAnalysis/Models/MemoryModel/MemModelTrait.h"
 #include "PointerAnalysis/Solver/PointsTo/BitVectorPTS.h"
 
 extern llvm::cl::opt<bool> ConfigPrintConstraintGraph;
 extern llvm::cl::opt<bool> ConfigPrintCallGraph;
 extern llvm::cl::opt<bool> ConfigDumpPointsToSet;
+extern llvm::cl::opt<bool> CONFIG_OFFLINE_REDUCTION;
 
 namespace pta {
 
@@ -83,6 +89,13 @@ class SolverBase {
   // some helper function that might be needed by subclasses
   constexpr inline bool processAddrOf(CGNodeTy *src, CGNodeTy *dst) const;
   inline bool processCopy(CGNodeTy *src, CGNodeTy *dst);
+  inline bool processDiffCopy(CGNodeTy *src, CGNodeTy *dst);
+  void reduceConsGraph();
+
+  // the objects of the pts to be handled, either all of them or only those added since the last clearDiff
+  [[nodiscard]] static inline const PtsTy &getHandledPts(CGNodeTy *node, bool diffOnly) {
+    return diffOnly ? PT::getDiffPointsTo(node->getNodeID()) : PT::getPointsTo(node->getNodeID());
+  }
 
   // TODO: only process diff pts
   template <typename CallBack = Noop>
@@ -154,12 +167,14 @@ class SolverBase {
   // src --LOAD-->dst
   // for every node in pts(src):
   //     node --COPY--> dst
+  // if diffOnly, only the objects added to pts(src) since its last clearDiff are handled
   template <typename CallBack = Noop>
-  bool processLoad(CGNodeTy *src, CGNodeTy *dst, CallBack callBack = Noop{}) {
+  bool processLoad(CGNodeTy *src, CGNodeTy *dst, CallBack callBack = Noop{}, bool diffOnly = false) {
     assert(!src->hasSuperNode() && !dst->hasSuperNode());
 
     bool changed = false;
-    for (auto it = PT::begin(src->getNodeID()), ie = PT::end(src->getNodeID()); it != ie; it++) {
+    const PtsTy &pts = getHandledPts(src, diffOnly);
+    for (auto it = pts.begin(), ie = pts.end(); it != ie; it++) {
       auto node = consGraph->getObjectNode(*it);
       node = node->getSuperNode();
       if (consGraph->addConstraints(node, dst, Constraints::copy)) {
@@ -199,16 +214,17 @@ class SolverBase {
     return changed;
   }
 
-  // TODO: only process diff pts
   // src --STORE-->dst
   // for every node in pts(dst):
   //      src --COPY--> node
+  // if diffOnly, only the objects added to pts(dst) since its last clearDiff are handled
   template <typename CallBack = Noop>
-  bool processStore(CGNodeTy *src, CGNodeTy *dst, CallBack callBack = Noop{}) {
+  bool processStore(CGNodeTy *src, CGNodeTy *dst, CallBack callBack = Noop{}, bool diffOnly = false) {
     assert(!src->hasSuperNode() && !dst->hasSuperNode());
 
     bool changed = false;
-    for (auto it = PT::begin(dst->getNodeID()), ie = PT::end(dst->getNodeID()); it != ie; it++) {
+    const PtsTy &pts = getHandledPts(dst, diffOnly);
+    for (auto it = pts.begin(), ie = pts.end(); it != ie; it++) {
       // auto tmp = llvm::dyn_cast<ObjNodeTy>(consGraph->getCGNode(*it));
       auto node = consGraph->getObjectNode(*it);
       node = node->getSuperNode();
@@ -293,6 +309,10 @@ class SolverBase {
 
     consGraph = LMT::getConsGraph(langModel.get());
 
+    if (CONFIG_OFFLINE_REDUCTION) {
+      reduceConsGraph();
+    }
+
     LOG_INFO("Pointer Analysis Starting to Solve");
 
     // subclass might override solve() directly for more aggressive overriding
@@ -486,6 +506,146 @@ bool SolverBase<LangModel, SubClass>::processCopy(CGNodeTy *src, CGNodeTy *dst)
   return false;
 }
 
+// pts(dst) |= diff(src), only valid if dst already contains everything src pointed to at its last clearDiff
+template <typename LangModel, typename SubClass>
+bool SolverBase<LangModel, SubClass>::processDiffCopy(CGNodeTy *src, CGNodeTy *dst) {
+  if (PT::unionWithDiff(dst->getNodeID(), src->getNodeID())) {
+    if (dst->isFunctionPtr()) {
+      // node used for indirect call
+      this->updateFunPtr(dst->getNodeID());
+    }
+    return true;
+  }
+  return false;
+}
+
+// Offline variable substitution by hash-based value numbering (HVN), run before solving.
+// Every node gets a label such that nodes with the same label provably have the same points-to set: a pointer that
+// can only get its pts through copy edges is labelled by the set of labels it copies from, every other node gets a
+// fresh label. The nodes sharing a label are then merged the same way as a copy SCC.
+// Only pointers of instructions that are not calls are relabelled, as no constraints are added into them once their
+// function is built. Arguments and call results get new incoming edges when indirect calls are resolved.
+template <typename LangModel, typename SubClass>
+void SolverBase<LangModel, SubClass>::reduceConsGraph() {
+  ConsGraphTy &graph = *consGraph;
+
+  auto const countEdges = [&]() {
+    size_t edges = 0;
+    for (auto it = graph.begin(), ie = graph.end(); it != ie; it++) {
+      CGNodeTy *node = *it;
+      for (auto eit = node->succ_edge_begin(), eie = node->succ_edge_end(); eit != eie; eit++) {
+        edges++;
+      }
+    }
+    return edges;
+  };
+
+  // whether the pts of node is fully determined by its incoming copy edges
+  auto const isSubstitutable = [](CGNodeTy *node) {
+    auto ptrNode = llvm::dyn_cast<PtrNodeTy>(node);
+    if (ptrNode == nullptr || ptrNode->isAnonNode() || node->isSpecialNode() || !PT::isEmpty(node->getNodeID())) {
+      return false;
+    }
+
+    auto inst = llvm::dyn_cast<llvm::Instruction>(ptrNode->getPointer()->getValue());
+    if (inst == nullptr || llvm::isa<llvm::CallBase>(inst)) {
+      return false;
+    }
+    return node->pred_load_begin() == node->pred_load_end() && node->pred_offset_begin() == node->pred_offset_end() &&
+           node->pred_special_begin() == node->pred_special_end();
+  };
+
+  const size_t edgesBefore = countEdges();
+
+  // copy SCCs in reverse topological order
+  std::vector<std::vector<CGNodeTy *>> sccs;
+  llvm::BitVector workList(graph.getNodeNum(), false);
+  for (auto it = scc_begin<ctx, Constraints::copy, false>(graph, workList),
+            ie = scc_end<ctx, Constraints::copy, false>(graph, workList);
+       it != ie; ++it) {
+    sccs.push_back(*it);
+  }
+
+  // nodes labelled EMPTY_LABEL never point to anything
+  constexpr unsigned EMPTY_LABEL = 0;
+  constexpr unsigned UNLABELLED = std::numeric_limits<unsigned>::max();
+  std::vector<unsigned> labels(graph.getNodeNum(), UNLABELLED);
+  std::map<std::vector<unsigned>, unsigned> labelOfSources;
+  // the nodes sharing a label, indexed by the label
+  std::vector<std::vector<CGNodeTy *>> nodesOfLabel(1);
+
+  auto const newLabel = [&]() {
+    nodesOfLabel.emplace_back();
+    return static_cast<unsigned>(nodesOfLabel.size() - 1);
+  };
+
+  for (auto sit = sccs.rbegin(), sie = sccs.rend(); sit != sie; sit++) {
+    const std::vector<CGNodeTy *> &scc = *sit;
+
+    unsigned label;
+    if (std::all_of(scc.begin(), scc.end(), isSubstitutable)) {
+      std::vector<unsigned> sources;
+      for (CGNodeTy *node : scc) {
+        for (auto it = node->pred_copy_begin(), ie = node->pred_copy_end(); it != ie; it++) {
+          // the copy predecessors outside of the SCC are all labelled already
+          unsigned predLabel = labels[(*it)->getNodeID()];
+          if (predLabel != UNLABELLED && predLabel != EMPTY_LABEL) {
+            sources.push_back(predLabel);
+          }
+        }
+      }
+      std::sort(sources.begin(), sources.end());
+      sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+      if (sources.empty()) {
+        label = EMPTY_LABEL;
+      } else if (sources.size() == 1) {
+        label = sources.front();
+      } else {
+        // cppcheck-suppress stlIfFind
+        if (auto it = labelOfSources.find(sources); it != labelOfSources.end()) {
+          label = it->second;
+        } else {
+          label = newLabel();
+          labelOfSources.emplace(std::move(sources), label);
+        }
+      }
+    } else {
+      // all nodes in a copy SCC have the same pts
+      label = newLabel();
+    }
+
+    for (CGNodeTy *node : scc) {
+      labels[node->getNodeID()] = label;
+      nodesOfLabel[label].push_back(node);
+    }
+  }
+
+  size_t mergedNodes = 0;
+  for (auto &nodes : nodesOfLabel) {
+    if (nodes.size() < 2) {
+      continue;
+    }
+
+    // keep the node whose pts is not determined by copies as the super node, new constraints go into it
+    auto superIt = std::find_if_not(nodes.begin(), nodes.end(), isSubstitutable);
+    if (superIt != nodes.end()) {
+      std::iter_swap(nodes.begin(), superIt);
+    }
+
+    CGNodeTy *superNode = nodes.front();
+    for (auto nit = ++(nodes.begin()), nie = nodes.end(); nit != nie; nit++) {
+      PT::unionWith(superNode->getNodeID(), (*nit)->getNodeID());
+      PT::clear((*nit)->getNodeID());
+    }
+    graph.collapseSCCTo(nodes, superNode);
+    mergedNodes += nodes.size() - 1;
+  }
+
+  LOG_INFO("PTA offline reduction merged {} of {} nodes, eliminated {} edges", mergedNodes, graph.getNodeNum(),
+           edgesBefore - countEdges());
+}
+
 }  // namespace pta
 
 #undef DEBUG_TYPE
@@ -11,44 +11,170 @@ limitations under the License.
 
 #include "RaceDetect.h"
 
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
 #include "Analysis/HappensBeforeGraph.h"
 #include "Analysis/LockSet.h"
 #include "Analysis/OpenMPAnalysis.h"
+#include "Analysis/RaceFilter.h"
+#include "Analysis/RaceVerdictCache.h"
 #include "Analysis/SharedMemory.h"
 #include "Analysis/SimpleAlias.h"
 #include "Analysis/ThreadLocalAnalysis.h"
+#include "Analysis/ThreadMHP.h"
 #include "LanguageModel/RaceModel.h"
+#include "PreProcessing/PreProcessing.h"
+#include "Reporter/ReportCache.h"
 #include "Statistics/Coverage.h"
 #include "Trace/ProgramTrace.h"
 
+// pointer analysis options, see PointerAnalysis/CMDOptions.cpp
+extern llvm::cl::opt<bool> USE_MEMLAYOUT_FILTERING;
+extern llvm::cl::opt<bool> CONFIG_VTABLE_MODE;
+extern llvm::cl::opt<bool> CONFIG_USE_FI_MODE;
+extern llvm::cl::opt<bool> CONFIG_OFFLINE_REDUCTION;
+extern llvm::cl::opt<pta::IndirectResolveOption> INDIRECT_OPTION;
+extern llvm::cl::opt<unsigned> Max_Indirect_Target;
+extern llvm::cl::opt<unsigned> ANON_REC_LIMIT;
+extern llvm::cl::opt<unsigned> ANON_REC_DEPTH_LIMIT;
+
 using namespace race;
 
+namespace {
+
+// Number of shared objects a race checking worker claims at a time
+constexpr size_t OBJ_CHUNK_SIZE = 16;
+
+// Number of access pairs a race checking worker checks between polls of the time/memory budget
+constexpr size_t BUDGET_CHECK_INTERVAL = 4096;
+
+// Peak resident memory of this process in megabytes
+size_t getPeakMemoryMB() {
+  struct rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  // ru_maxrss is reported in kilobytes on Linux
+  return static_cast<size_t>(usage.ru_maxrss) / 1024;
+}
+
+// return true if obj is a global variable
+bool isGlobalObject(const pta::ObjTy *obj) { return llvm::isa_and_nonnull<llvm::GlobalVariable>(obj->getValue()); }
+
+void dumpIR(const llvm::Module &module, const std::string &path) {
+  std::error_code err;
+  llvm::raw_fd_ostream outfile(path, err);
+  if (err) {
+    llvm::errs() << "Error dumping preprocessed IR!\n";
+  } else {
+    module.print(outfile, nullptr);
+    outfile.close();
+  }
+}
+
+void dumpStats(const nlohmann::json &stats, const std::string &path) {
+  std::ofstream output(path, std::ofstream::out);
+  output << stats.dump(2);
+  output.close();
+}
+
+// Options that change how the program is analyzed, used as part of the report cache key
+// This includes the pointer analysis command line options, which are global rather than part of config.
+// The race filters are fixed in the tool binary, which is hashed into the key as well.
+// Options that only decide when checking stops early are left out, because incomplete reports are never cached,
+// and so are options that only produce extra output or set the number of workers.
+std::string getCacheOptions(const DetectRaceConfig &config) {
+  std::string options;
+  llvm::raw_string_ostream os(options);
+  os << "entry=main"
+     << ",max-call-depth=" << config.traceBudget.maxCallDepth
+     << ",max-thread-events=" << config.traceBudget.maxThreadEvents
+     << ",skip-thread-private=" << config.skipThreadPrivate << ",coalesce-accesses=" << config.coalesceAccesses
+     << ",elide-call-events=" << config.elideCallEvents << ",share-call-segments=" << config.shareCallSegments
+     << ",hb-backend=" << static_cast<int>(config.hbBackend);
+  os << ",Xmemlayout-filtering=" << USE_MEMLAYOUT_FILTERING << ",Xenable-vtable=" << CONFIG_VTABLE_MODE
+     << ",Xuse-fi-model=" << CONFIG_USE_FI_MODE << ",Xoffline-reduction=" << CONFIG_OFFLINE_REDUCTION
+     << ",INDIRECT_OPTION=" << static_cast<int>(INDIRECT_OPTION.getValue())
+     << ",Max_Indirect_Target=" << Max_Indirect_Target << ",ANON_REC_LIMIT=" << ANON_REC_LIMIT
+     << ",ANON_REC_DEPTH_LIMIT=" << ANON_REC_DEPTH_LIMIT;
+  return os.str();
+}
+
+}  // namespace
+
 Report race::detectRaces(llvm::Module *module, DetectRaceConfig config) {
-  race::ProgramTrace program(module);
+  auto const startTime = std::chrono::steady_clock::now();
 
-  if (config.dumpPreprocessedIR.has_value()) {
-    std::error_code err;
-    llvm::raw_fd_ostream outfile(config.dumpPreprocessedIR.value(), err);
-    if (err) {
-      llvm::errs() << "Error dumping preprocessed IR!\n";
+  unsigned int numWorkers = config.numWorkers;
+  if (numWorkers == 0) {
+    numWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  std::optional<race::ReportCache> cache;
+  std::string cacheKey;
+  if (config.cacheDir.has_value()) {
+    // The key must be computed before the module is modified by preprocessing
+    if (auto key = race::ReportCache::getKey(*module, getCacheOptions(config))) {
+      cache.emplace(config.cacheDir.value());
+      cacheKey = key.value();
     } else {
-      program.getModule().print(outfile, nullptr);
-      outfile.close();
+      llvm::errs() << "Could not read the tool binary, race reports will not be cached\n";
+    }
+  }
+  // Filter statistics are only collected while checking, so a cached report cannot come with them.
+  // The report is still stored, so later runs without filter statistics can use it
+  if (cache.has_value() && !config.dumpFilterStats.has_value()) {
+    if (auto entry = cache->lookup(cacheKey)) {
+      // Cached races refer to instructions of the preprocessed module
+      preprocess(*module);
+      if (config.dumpPreprocessedIR.has_value()) {
+        dumpIR(*module, config.dumpPreprocessedIR.value());
+      }
+      if (config.printTrace || config.doCoverage) {
+        llvm::errs() << "Race report loaded from cache directory " << config.cacheDir.value()
+                     << ", the program trace and coverage are not printed\n";
+      }
+      return entry->resolve(*module);
     }
   }
 
+  race::ProgramTrace program(module, "main", numWorkers, config.traceBudget, config.skipThreadPrivate,
+                             config.elideCallEvents, config.shareCallSegments);
+  if (DEBUG_PTA && program.getEscapeAnalysis()) {
+    llvm::outs() << "Thread private objects: " << program.getEscapeAnalysis()->numThreadPrivate() << "\n";
+  }
+  if (DEBUG_PTA) {
+    llvm::outs() << "Isomorphic thread classes: " << program.numThreadClasses() << " for "
+                 << program.getThreads().size() << " threads\n";
+  }
+
+  if (config.dumpPreprocessedIR.has_value()) {
+    dumpIR(program.getModule(), config.dumpPreprocessedIR.value());
+  }
+
   if (config.printTrace) {
     llvm::outs() << program << "\n";
   }
 
-  race::SharedMemory sharedmem(program);
-  race::HappensBeforeGraph happensbefore(program);
+  race::SharedMemory sharedmem(program, config.coalesceAccesses);
+  if (DEBUG_PTA) {
+    llvm::outs() << "Coalesced " << sharedmem.numCoalesced() << " repeated accesses\n";
+  }
+  race::HappensBeforeGraph happensbefore(program, config.hbBackend);
   race::LockSet lockset(program);
   race::SimpleAlias simpleAlias;
   race::OpenMPAnalysis ompAnalysis(program);
   race::ThreadLocalAnalysis threadlocal;
+  race::ThreadMHP threadMHP(program, happensbefore);
+  race::RaceVerdictCache verdicts;
 
-  race::Reporter reporter;
+  // SimpleAlias and OpenMPAnalysis query LLVM analyses that lazily create IR constants in the (shared) LLVMContext,
+  // which is not thread safe. Workers must hold this lock while using them.
+  std::mutex llvmAnalysisLock;
 
   llvm::PassBuilder PB;
   llvm::FunctionAnalysisManager FAM;
@@ -57,8 +183,61 @@ Report race::detectRaces(llvm::Module *module, DetectRaceConfig config) {
   // but i do not know how to register it properly now
   // FAM.registerPass([&] { return PB.buildDefaultAAPipeline(); });
 
+  // Set once the race limit or the time/memory budget is reached, after which workers stop checking
+  std::atomic<bool> stopChecking = false;
+
+  auto const budgetExceeded = [&]() {
+    if (config.timeBudget.count() > 0 && std::chrono::steady_clock::now() - startTime > config.timeBudget) {
+      return true;
+    }
+    return config.memoryBudgetMB > 0 && getPeakMemoryMB() > config.memoryBudgetMB;
+  };
+
+  // Count pairs towards the next budget poll of one worker, and stop checking once the budget is exceeded.
+  // Objects can have many accesses, so the budget is polled while checking them and not only between objects
+  auto const pollBudget = [&](size_t &pairsSincePoll, size_t pairs) {
+    pairsSincePoll += pairs;
+    if (pairsSincePoll < BUDGET_CHECK_INTERVAL) return;
+    pairsSincePoll = 0;
+    if (budgetExceeded()) {
+      stopChecking = true;
+    }
+  };
+
+  // Distinct instruction pairs reported so far, only tracked when the number of races is limited
+  // Pairs without debug locations are dropped from the report, so they are not counted
+  std::mutex foundRacesLock;
+  std::set<std::pair<const llvm::Instruction *, const llvm::Instruction *>> foundRaces;
+  auto const countRace = [&](const race::WriteEvent *write, const race::MemAccessEvent *other) {
+    if (!write->getInst()->getDebugLoc() || !other->getInst()->getDebugLoc()) return;
+
+    std::lock_guard<std::mutex> guard(foundRacesLock);
+    foundRaces.insert(std::minmax(write->getInst(), other->getInst()));
+    if (foundRaces.size() >= config.maxRaces) {
+      stopChecking = true;
+    }
+  };
+
+  // Per-access filters, run in order until one of them rules out a race
+  race::RaceFilterPipeline filters;
+  filters.add(std::make_unique<race::SimpleAliasFilter>(simpleAlias));
+  filters.add(std::make_unique<race::OpenMPLoopFilter>(ompAnalysis));
+  filters.add(std::make_unique<race::OpenMPSingleFilter>(ompAnalysis));
+  filters.add(std::make_unique<race::OpenMPReduceFilter>(ompAnalysis));
+  filters.add(std::make_unique<race::OpenMPSectionsFilter>(ompAnalysis));
+  filters.add(std::make_unique<race::OpenMPGuardedTIDFilter>(ompAnalysis));
+  filters.add(std::make_unique<race::OpenMPLastprivateFilter>(ompAnalysis));
+
+  // Return false if any filter can rule out a race between write and other
+  // The result only depends on the instructions and their position within an OpenMP team, see RaceVerdictCache
+  auto filterRace = [&](const race::WriteEvent *write, const race::MemAccessEvent *other) {
+    std::lock_guard<std::mutex> guard(llvmAnalysisLock);
+    return !filters.rejects(write, other);
+  };
+
   // Adds to report if race is detected between write and other
-  auto checkRace = [&](const race::WriteEvent *write, const race::MemAccessEvent *other) {
+  // Happens-before and lockset have already been checked for the intervals containing write and other
+  auto checkRace = [&](const race::WriteEvent *write, const race::MemAccessEvent *other, race::Reporter &reporter) {
     if (DEBUG_PTA) {
       llvm::outs() << "Checking Race: " << write->getID() << "(TID " << write->getThread().id << ") "
                    << "(line" << write->getIRInst()->getInst()->getDebugLoc().getLine()  // DRB149 crash on this line
@@ -70,79 +249,178 @@ Report race::detectRaces(llvm::Module *module, DetectRaceConfig config) {
       llvm::outs() << " (IR: " << *write->getInst() << "\n\t" << *other->getInst() << ")\n";
     }
 
-    if (!happensbefore.areParallel(write, other) || lockset.sharesLock(write, other)) {
+    if (threadlocal.isThreadLocalAccess(write, other)) {
       return;
     }
 
-    if (threadlocal.isThreadLocalAccess(write, other)) {
-      return;
+    auto const sameTeam = ompAnalysis.fromSameParallelRegion(write, other);
+    auto const key = race::RaceVerdictCache::getKey(write, other, sameTeam);
+    auto verdict = verdicts.lookup(key);
+    if (!verdict.has_value()) {
+      verdict = filterRace(write, other);
+      verdicts.insert(key, verdict.value());
     }
 
-    if (simpleAlias.mustNotAlias(write, other)) {
+    if (!verdict.value()) {
       return;
     }
 
-    if (ompAnalysis.fromSameParallelRegion(write, other)) {
-      // Non overlapping array accesses inside of an OpenMP loop are not races
-      // e.g.
-      //  #pragma omp parallel for shared(A)
-      //  for (int i = 0; i < N: i++) { A[i] = i; }
-      // even though A is shared, each index is unique so there is no race
-      if (ompAnalysis.isNonOverlappingLoopAccess(write, other)) {
-        return;
+    // Race detected, also on every access coalesced into write or other as they share the same verdict
+    auto const reportRace = [&](const race::WriteEvent *raceWrite, const race::MemAccessEvent *raceOther) {
+      reporter.collect(raceWrite, raceOther);
+      if (config.maxRaces > 0) {
+        countRace(raceWrite, raceOther);
       }
-
-      // Certain omp blocks cannot race with themselves or those of the same type within the same scope/team
-      if (ompAnalysis.inSameSingleBlock(write, other) || ompAnalysis.inSameReduce(write, other) ||
-          race::OpenMPAnalysis::insideCompatibleSections(write, other)) {
-        return;
+    };
+    auto const coalescedOthers = sharedmem.getCoalesced(other);
+    reportRace(write, other);
+    for (auto const coalescedOther : coalescedOthers) {
+      reportRace(write, coalescedOther);
+    }
+    for (auto const coalesced : sharedmem.getCoalesced(write)) {
+      auto const coalescedWrite = llvm::cast<race::WriteEvent>(coalesced);
+      reportRace(coalescedWrite, other);
+      for (auto const coalescedOther : coalescedOthers) {
+        reportRace(coalescedWrite, coalescedOther);
       }
+    }
 
-      // No race if guaranteed to be executed by same thread
-      if (ompAnalysis.guardedBySameTID(write, other)) return;
+    if (DEBUG_PTA) {
+      llvm::outs() << " ... is race\n";
+    }
+  };
+
+  // Interval pairs of one object already checked access by access, by thread class and interval position
+  using CheckedIntervals = std::set<std::tuple<race::ThreadClassID, size_t, race::ThreadClassID, size_t>>;
+
+  // Happens-before and lockset are decided once for each pair of sync intervals.
+  // Only intervals that may run in parallel without holding a common lock are checked access by access.
+  // The accesses of isomorphic threads find the same races, so they are checked once per pair of thread classes.
+  auto checkIntervals = [&](const auto &writeInterval, const auto &otherInterval, CheckedIntervals &checked,
+                            race::Reporter &reporter, size_t &pairsSincePoll) {
+    pollBudget(pairsSincePoll, 1);
+    if (stopChecking) return;
 
-      // Lastprivate code will only be executed by one thread
-      // Model lastprivate by assuming lastprivate code cannot race with other last private code
-      // This may miss races according to OpenMP specification,
-      //  but will not miss races according to how Clang generates OpenMP code (as of clang 10.0.1)
-      if (ompAnalysis.isInLastprivate(write) && ompAnalysis.isInLastprivate(other)) return;
+    auto const writeAnchor = writeInterval.anchor;
+    auto const otherAnchor = otherInterval.anchor;
+    if (!happensbefore.areParallel(writeAnchor, otherAnchor) || lockset.sharesLock(writeAnchor, otherAnchor)) {
+      return;
     }
 
-    // Race detected
-    reporter.collect(write, other);
+    auto const writeClass = program.getThreadClass(writeAnchor->getThread().id);
+    auto const otherClass = program.getThreadClass(otherAnchor->getThread().id);
+    if (!checked.emplace(writeClass, writeInterval.id, otherClass, otherInterval.id).second) {
+      return;
+    }
 
-    if (DEBUG_PTA) {
-      llvm::outs() << " ... is race\n";
+    for (auto write : writeInterval.events) {
+      pollBudget(pairsSincePoll, otherInterval.events.size());
+      if (stopChecking) return;
+      for (auto other : otherInterval.events) {
+        checkRace(write, other, reporter);
+      }
     }
   };
 
-  for (auto const sharedObj : sharedmem.getSharedObjects()) {
-    auto threadedWrites = sharedmem.getThreadedWrites(sharedObj);
-    auto threadedReads = sharedmem.getThreadedReads(sharedObj);
+  // Check every write/read and write/write pair on a single shared object
+  auto checkObject = [&](const pta::ObjTy *sharedObj, race::Reporter &reporter, size_t &pairsSincePoll) {
+    auto const threadedWrites = sharedmem.getThreadedWrites(sharedObj);
+    auto const threadedReads = sharedmem.getThreadedReads(sharedObj);
+    CheckedIntervals checked;
 
     for (auto it = threadedWrites.begin(), end = threadedWrites.end(); it != end; ++it) {
-      auto const wtid = it->first;
-      auto const writes = it->second;
+      auto const wtid = it->tid;
+      auto const &writeIntervals = it->intervals;
       // check Read/Write race
-      for (auto const &[rtid, reads] : threadedReads) {
-        if (wtid == rtid) continue;
-        for (auto write : writes) {
-          for (auto read : reads) {
-            checkRace(write, read);
+      for (auto const &[rtid, readIntervals] : threadedReads) {
+        if (wtid == rtid || !threadMHP.mayOverlap(wtid, rtid)) continue;
+        for (auto const &writeInterval : writeIntervals) {
+          for (auto const &readInterval : readIntervals) {
+            checkIntervals(writeInterval, readInterval, checked, reporter, pairsSincePoll);
           }
         }
       }
 
       // Check write/write
       for (auto wit = std::next(it, 1); wit != end; ++wit) {
-        auto otherWrites = wit->second;
-        for (auto write : writes) {
-          for (auto otherWrite : otherWrites) {
-            checkRace(write, otherWrite);
+        if (!threadMHP.mayOverlap(wtid, wit->tid)) continue;
+        auto const &otherWriteIntervals = wit->intervals;
+        for (auto const &writeInterval : writeIntervals) {
+          for (auto const &otherWriteInterval : otherWriteIntervals) {
+            checkIntervals(writeInterval, otherWriteInterval, checked, reporter, pairsSincePoll);
           }
         }
       }
     }
+  };
+
+  // Objects only accessed by threads that can never run in parallel are dropped before any per-event checks
+  auto sharedObjects = threadMHP.pruneSharedObjects(sharedmem);
+
+  // When checking may stop early, check the objects most likely to race first:
+  // objects written without holding a lock, then globals, then objects written by more threads
+  if (config.maxRaces > 0 || config.timeBudget.count() > 0 || config.memoryBudgetMB > 0) {
+    auto const getRaceLikelihood = [&](const pta::ObjTy *obj) {
+      auto const threadedWrites = sharedmem.getThreadedWrites(obj);
+      bool unlockedWrite = false;
+      for (auto const &writes : threadedWrites) {
+        for (auto const &interval : writes.intervals) {
+          unlockedWrite |= lockset.getLockSetID(interval.anchor) == 0;
+        }
+      }
+      return std::make_tuple(unlockedWrite, isGlobalObject(obj), threadedWrites.size());
+    };
+
+    std::vector<std::pair<std::tuple<bool, bool, size_t>, const pta::ObjTy *>> ranked;
+    ranked.reserve(sharedObjects.size());
+    for (auto const obj : sharedObjects) {
+      ranked.emplace_back(getRaceLikelihood(obj), obj);
+    }
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [](auto const &lhs, auto const &rhs) { return lhs.first > rhs.first; });
+    std::transform(ranked.begin(), ranked.end(), sharedObjects.begin(), [](auto const &rank) { return rank.second; });
+  }
+
+  // Shared objects are split into fixed size chunks that workers claim one at a time.
+  // Each chunk collects races into its own reporter, and the reporters are merged in chunk order,
+  // so the final report does not depend on how many workers there are or how chunks were scheduled.
+  auto const numChunks = (sharedObjects.size() + OBJ_CHUNK_SIZE - 1) / OBJ_CHUNK_SIZE;
+  std::vector<race::Reporter> chunkReporters(numChunks);
+  std::atomic<size_t> nextChunk = 0;
+
+  auto const worker = [&]() {
+    size_t pairsSincePoll = 0;
+    for (auto chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++) {
+      if (stopChecking || budgetExceeded()) {
+        stopChecking = true;
+        return;
+      }
+
+      auto const begin = chunk * OBJ_CHUNK_SIZE;
+      auto const end = std::min(begin + OBJ_CHUNK_SIZE, sharedObjects.size());
+      for (auto i = begin; i < end && !stopChecking; ++i) {
+        checkObject(sharedObjects.at(i), chunkReporters.at(chunk), pairsSincePoll);
+      }
+    }
+  };
+
+  auto const numCheckWorkers = std::min<size_t>(numWorkers, numChunks);
+  if (numCheckWorkers <= 1) {
+    worker();
+  } else {
+    std::vector<std::thread> workers;
+    workers.reserve(numCheckWorkers);
+    for (size_t i = 0; i < numCheckWorkers; ++i) {
+      workers.emplace_back(worker);
+    }
+    for (auto &thread : workers) {
+      thread.join();
+    }
+  }
+
+  race::Reporter reporter;
+  for (auto const &chunkReporter : chunkReporters) {
+    reporter.merge(chunkReporter);
   }
 
   if (DEBUG_PTA) {
@@ -153,10 +431,29 @@ Report race::detectRaces(llvm::Module *module, DetectRaceConfig config) {
     happensbefore.debugDump(llvm::outs());
   }
 
+  if (config.dumpFilterStats.has_value()) {
+    nlohmann::json stats;
+    stats["filters"] = filters.getStatsJSON();
+    stats["threadMHP"] = {
+        {"prunedObjects", threadMHP.getNumPrunedObjects()},
+        {"prunedThreadPairs", threadMHP.getNumPrunedPairs()},
+    };
+    stats["verdictCache"] = {
+        {"hits", verdicts.getHits()},
+        {"misses", verdicts.getMisses()},
+    };
+    dumpStats(stats, config.dumpFilterStats.value());
+  }
+
   if (config.doCoverage) {
     race::Coverage coverage(program);
     llvm::outs() << coverage << "\n";
   }
 
-  return reporter.getReport();
+  auto report = reporter.getReport();
+  report.complete = !stopChecking && !program.isTruncated();
+  if (cache.has_value() && !cache->store(cacheKey, report, program.getModule()) && report.complete) {
+    llvm::errs() << "Could not write race report to cache directory " << config.cacheDir.value() << "\n";
+  }
+  return report;
 }
@@ -11,6 +11,9 @@ limitations under the License.
 
 #pragma once
 
+#include <chrono>
+
+#include "Analysis/HappensBeforeGraph.h"
 #include "Reporter/Reporter.h"
 
 namespace race {
@@ -24,6 +27,51 @@ struct DetectRaceConfig {
 
   // Compute and print the coverage (= analyzed source code/all source code)
   bool doCoverage = false;
+
+  // Number of worker threads used by pointer analysis, to build thread traces and to check shared objects for races
+  // (0 uses all available cores). The report is identical regardless of the number of workers
+  unsigned int numWorkers = 1;
+
+  // How happens-before reachability between sync events is computed
+  HappensBeforeGraph::Backend hbBackend = HappensBeforeGraph::Backend::Reachability;
+
+  // writes race checking statistics as JSON to a file specified by the string: per race filter invocations,
+  // rejections and time, the shared objects and thread pairs pruned by the thread MHP prefilter, and the hits and
+  // misses of the race verdict cache
+  std::optional<std::string> dumpFilterStats;
+
+  // Stop checking for races once this many have been found (0 checks everything)
+  // The returned report is marked incomplete if checking stopped early
+  size_t maxRaces = 0;
+
+  // Stop checking for races once the analysis has run for this long (0 means no limit)
+  std::chrono::milliseconds timeBudget{0};
+
+  // Stop checking for races once peak memory usage exceeds this many megabytes (0 means no limit)
+  size_t memoryBudgetMB = 0;
+
+  // Limits on the depth and length of each thread trace
+  // The returned report is marked incomplete if any thread trace was cut short
+  TraceBudget traceBudget;
+
+  // Leave loads/stores of stack and heap objects that never escape their function out of the trace
+  bool skipThreadPrivate = true;
+
+  // Check repeated accesses to the same value in a basic block once, see SharedMemory::getCoalesced
+  // Races are still reported for every coalesced access
+  bool coalesceAccesses = true;
+
+  // Leave Call/CallEnd events out of thread traces, calls are only recorded in ThreadTrace::getCalls
+  bool elideCallEvents = false;
+
+  // Traverse each function once per context and thread, later calls to it refer to the events of the first call
+  // see ThreadTrace::getSegmentRefs
+  bool shareCallSegments = false;
+
+  // Directory of the on-disk report cache, see ReportCache
+  // The cache is not read if dumpFilterStats is set. On a cache hit the module is only preprocessed, so neither the
+  // trace nor coverage are printed, and a warning says so
+  std::optional<std::string> cacheDir;
 };
 
 Report detectRaces(llvm::Module *module, DetectRaceConfig config = DetectRaceConfig());
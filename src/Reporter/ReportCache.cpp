@@ -0,0 +1,199 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "Reporter/ReportCache.h"
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/Path.h>
+
+using namespace race;
+
+namespace {
+
+// Bump whenever the file layout changes. Changes to the analysis are covered by the tool hash in the key
+constexpr uint32_t CACHE_VERSION = 2;
+constexpr llvm::StringLiteral CACHE_MAGIC = "ORRC";
+
+// Layout of a cache entry, all fields are little endian uint32_t
+//   header: magic, version, number of instructions in the preprocessed module, number of races
+//   races:  first instruction index, first access type, second instruction index, second access type
+constexpr size_t HEADER_SIZE = 4 * sizeof(uint32_t);
+constexpr size_t RACE_SIZE = 4 * sizeof(uint32_t);
+
+// Every instruction in module, in a stable order so instructions can be referred to by index
+std::vector<const llvm::Instruction *> getInstructions(const llvm::Module &module) {
+  std::vector<const llvm::Instruction *> insts;
+  for (auto const &func : module) {
+    for (auto const &block : func) {
+      for (auto const &inst : block) {
+        insts.push_back(&inst);
+      }
+    }
+  }
+  return insts;
+}
+
+// MD5 of the binary this code is linked into, computed once per run
+// std::nullopt if the binary cannot be found or read
+const std::optional<llvm::MD5::MD5Result> &getToolHash() {
+  static const auto toolHash = []() -> std::optional<llvm::MD5::MD5Result> {
+    auto const path = llvm::sys::fs::getMainExecutable(nullptr, reinterpret_cast<void *>(&getInstructions));
+    if (path.empty()) return std::nullopt;
+
+    auto buffer = llvm::MemoryBuffer::getFile(path, -1, /*RequiresNullTerminator=*/false);
+    if (!buffer) return std::nullopt;
+
+    llvm::MD5 hash;
+    hash.update(buffer.get()->getBuffer());
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    return result;
+  }();
+  return toolHash;
+}
+
+uint32_t readField(const char *data, size_t index) {
+  return llvm::support::endian::read32le(data + index * sizeof(uint32_t));
+}
+
+std::optional<Event::Type> toAccessType(uint32_t raw) {
+  auto const type = static_cast<Event::Type>(raw);
+  if (type != Event::Type::Read && type != Event::Type::Write) return std::nullopt;
+  return type;
+}
+
+}  // namespace
+
+std::optional<std::string> ReportCache::getKey(const llvm::Module &module, llvm::StringRef options) {
+  auto const &toolHash = getToolHash();
+  if (!toolHash) return std::nullopt;
+
+  llvm::SmallVector<char, 0> bitcode;
+  llvm::raw_svector_ostream os(bitcode);
+  llvm::WriteBitcodeToFile(module, os);
+
+  llvm::MD5 hash;
+  hash.update(llvm::StringRef(bitcode.data(), bitcode.size()));
+  hash.update(options);
+  hash.update(std::to_string(CACHE_VERSION));
+  hash.update(llvm::ArrayRef<uint8_t>(toolHash->Bytes));
+
+  llvm::MD5::MD5Result result;
+  hash.final(result);
+  return result.digest().str().str();
+}
+
+std::string ReportCache::getPath(llvm::StringRef key) const {
+  llvm::SmallString<128> path(directory);
+  llvm::sys::path::append(path, key + ".races");
+  return path.str().str();
+}
+
+std::optional<ReportCache::Entry> ReportCache::lookup(llvm::StringRef key) const {
+  // Not null terminated so that large entries are mapped into memory rather than read
+  auto buffer = llvm::MemoryBuffer::getFile(getPath(key), -1, /*RequiresNullTerminator=*/false);
+  if (!buffer) return std::nullopt;
+
+  auto const data = buffer.get()->getBuffer();
+  if (data.size() < HEADER_SIZE || !data.startswith(CACHE_MAGIC) || readField(data.data(), 1) != CACHE_VERSION) {
+    return std::nullopt;
+  }
+
+  auto const numRaces = readField(data.data(), 3);
+  if (data.size() != HEADER_SIZE + numRaces * RACE_SIZE) return std::nullopt;
+
+  return Entry(std::move(buffer.get()));
+}
+
+Report ReportCache::Entry::resolve(const llvm::Module &module) const {
+  auto const insts = getInstructions(module);
+  auto const data = buffer->getBufferStart();
+
+  Report report;
+  report.fromCache = true;
+  report.complete = readField(data, 2) == insts.size();
+  if (!report.complete) return report;
+
+  auto const numRaces = readField(data, 3);
+  auto const races = data + HEADER_SIZE;
+  for (size_t i = 0; i < numRaces; ++i) {
+    auto const race = races + i * RACE_SIZE;
+    auto const first = readField(race, 0);
+    auto const firstType = toAccessType(readField(race, 1));
+    auto const second = readField(race, 2);
+    auto const secondType = toAccessType(readField(race, 3));
+    if (first >= insts.size() || second >= insts.size() || !firstType || !secondType) {
+      report.complete = false;
+      continue;
+    }
+
+    Race resolved(RaceAccess(insts[first], firstType.value()), RaceAccess(insts[second], secondType.value()));
+    if (resolved.missingLocation()) {
+      report.complete = false;
+      continue;
+    }
+    report.races.insert(resolved);
+  }
+
+  if (!report.complete) {
+    llvm::errs() << "Cached race report does not match the module, some races may be missing\n";
+  }
+  return report;
+}
+
+bool ReportCache::store(llvm::StringRef key, const Report &report, const llvm::Module &module) const {
+  if (!report.complete) return false;
+
+  auto const insts = getInstructions(module);
+  llvm::DenseMap<const llvm::Instruction *, uint32_t> indices;
+  for (size_t i = 0; i < insts.size(); ++i) {
+    indices[insts[i]] = i;
+  }
+
+  if (llvm::sys::fs::create_directories(directory)) return false;
+
+  // Write to a temporary file first so concurrent runs never see a partially written entry
+  int fd;
+  llvm::SmallString<128> tmpPath;
+  if (llvm::sys::fs::createUniqueFile(getPath(key) + ".tmp%%%%%%", fd, tmpPath)) return false;
+
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    llvm::support::endian::Writer writer(os, llvm::support::little);
+    os << CACHE_MAGIC;
+    writer.write<uint32_t>(CACHE_VERSION);
+    writer.write<uint32_t>(insts.size());
+    writer.write<uint32_t>(report.races.size());
+    for (auto const &race : report.races) {
+      for (auto const &access : {race.first, race.second}) {
+        writer.write<uint32_t>(indices.lookup(access.inst));
+        writer.write<uint32_t>(static_cast<uint32_t>(access.type));
+      }
+    }
+
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(tmpPath);
+      return false;
+    }
+  }
+
+  if (llvm::sys::fs::rename(tmpPath, getPath(key))) {
+    llvm::sys::fs::remove(tmpPath);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,69 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "Reporter/Reporter.h"
+
+namespace race {
+
+// Persists race reports on disk so that analyzing an unchanged module with the same options again can skip pointer
+// analysis, trace building and race checking.
+//
+// Entries are keyed by a hash of the module as it was before preprocessing, together with the options that change the
+// result and a hash of the tool binary. Reports only depend on the code of the tool (analyses, race filters and their
+// order) through the binary, so a rebuilt tool never loads reports stored by another build.
+// Racing instructions are stored by their index in the preprocessed module, so loading an entry needs the same module,
+// preprocessed the same way.
+class ReportCache {
+ public:
+  // A cache entry mapped into memory whose header has been checked
+  class Entry {
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+
+    explicit Entry(std::unique_ptr<llvm::MemoryBuffer> buffer) : buffer(std::move(buffer)) {}
+    friend class ReportCache;
+
+   public:
+    // Rebuild the cached report on the preprocessed module
+    // The report is marked incomplete if any racing instruction could not be found in module
+    [[nodiscard]] Report resolve(const llvm::Module &module) const;
+  };
+
+  explicit ReportCache(llvm::StringRef directory) : directory(directory) {}
+
+  // Compute the key of module, which must not have been preprocessed yet
+  // options should contain every option that can change the report
+  // Return std::nullopt if the tool binary cannot be read, in which case reports should not be cached
+  [[nodiscard]] static std::optional<std::string> getKey(const llvm::Module &module, llvm::StringRef options);
+
+  // Find the entry stored under key, or std::nullopt if there is none or it cannot be read
+  [[nodiscard]] std::optional<Entry> lookup(llvm::StringRef key) const;
+
+  // Store report, computed on the preprocessed module, under key
+  // Incomplete reports are not stored as they depend on when checking stopped. Return false on failure.
+  bool store(llvm::StringRef key, const Report &report, const llvm::Module &module) const;
+
+ private:
+  std::string directory;
+
+  [[nodiscard]] std::string getPath(llvm::StringRef key) const;
+};
+
+}  // namespace race
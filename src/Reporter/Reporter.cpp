@@ -19,8 +19,8 @@ using namespace race;
 
 namespace {
 
-std::optional<SourceLoc> getSourceLoc(const Event *e) {
-  auto const &loc = e->getInst()->getDebugLoc();
+std::optional<SourceLoc> getSourceLoc(const llvm::Instruction *inst) {
+  auto const &loc = inst->getDebugLoc();
   if (auto diloc = loc.get()) {
     return SourceLoc(diloc);
   }
@@ -46,7 +46,12 @@ llvm::raw_ostream &race::operator<<(llvm::raw_ostream &os, const SourceLoc &loc)
 }
 
 RaceAccess::RaceAccess(const MemAccessEvent *event)
-    : location(getSourceLoc(event)), type(event->type), inst(event->getInst()) {
+    : location(getSourceLoc(event->getInst())), type(event->type), inst(event->getInst()) {
+  updateMisleadingDebugLoc();
+}
+
+RaceAccess::RaceAccess(const llvm::Instruction *inst, Event::Type type)
+    : location(getSourceLoc(inst)), type(type), inst(inst) {
   updateMisleadingDebugLoc();
 }
 
@@ -129,6 +134,10 @@ void Reporter::collect(const WriteEvent *e1, const MemAccessEvent *e2) {
   racepairs.emplace_back(std::make_pair(e1, e2));
 }
 
+void Reporter::merge(const Reporter &other) {
+  racepairs.insert(racepairs.end(), other.racepairs.begin(), other.racepairs.end());
+}
+
 Report Reporter::getReport() const { return Report(racepairs); }
 
 llvm::raw_ostream &race::operator<<(llvm::raw_ostream &os, const Race &race) {
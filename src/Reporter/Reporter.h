@@ -60,6 +60,7 @@ struct RaceAccess {
   const llvm::Instruction *inst;
 
   RaceAccess(const MemAccessEvent *event);
+  RaceAccess(const llvm::Instruction *inst, Event::Type type);
 
   bool sameLocation(const RaceAccess &other) const { return location == other.location; }
 
@@ -100,6 +101,14 @@ class Report {
  public:
   std::set<Race> races;
 
+  // False if race checking stopped early (race limit or time/memory budget) or a thread trace was truncated
+  // (trace budget), so races may be missing
+  bool complete = true;
+
+  // True if the report was loaded from a ReportCache instead of being computed
+  bool fromCache = false;
+
+  Report() = default;
   Report(const std::vector<std::pair<const WriteEvent *, const MemAccessEvent *>> &rawRaces);
 
   inline bool empty() { return races.empty(); };
@@ -114,6 +123,9 @@ class Reporter {
  public:
   void collect(const WriteEvent *e1, const MemAccessEvent *e2);
 
+  // append all races collected by other, keeping the order they were collected in
+  void merge(const Reporter &other);
+
   [[nodiscard]] Report getReport() const;
 };
 
@@ -62,33 +62,34 @@ void Coverage::summarize() {
   }
 
   // collect fns in program
+  // Calls are read from the call table of each thread, so this also works when call events are left out of the trace
   for (auto const &thread : program.getThreads()) {
-    if (thread->getEvents().empty()) {  // a thread with an empty trace, e.g., atomic
+    if (thread->getEvents().empty() && thread->getCalls().empty()) {  // a thread with an empty trace, e.g., atomic
+      if (!thread->spawnSite.has_value()) continue;
       auto entry = thread->spawnSite.value()->getIRInst()->getThreadEntry();
       if (auto fn = llvm::dyn_cast<llvm::Function>(entry)) recordFn(data.analyzed, fn);
       continue;
     }
 
-    auto _1stEvent = thread->getEvents().front().get();
-    recordFn(data.analyzed, _1stEvent->getFunction());
+    // the first call is always made by the thread entry, and without calls every event is made by the entry
+    auto const &events = thread->getEvents();
+    auto const &calls = thread->getCalls();
+    if (!calls.empty()) {
+      recordFn(data.analyzed, calls.front().call->getInst()->getFunction());
+    } else {
+      recordFn(data.analyzed, events.front()->getFunction());
+    }
 
-    for (auto const &event : thread->getEvents()) {
-      switch (event->type) {
-        case Event::Type::Call: {
-          auto call = llvm::cast<EnterCallEvent>(event.get());
-          auto fn = call->getCalledFunction();
-          recordFn(data.analyzed, fn);
-          break;
-        }
-        case Event::Type::Fork: {
-          auto fork = llvm::cast<ForkEvent>(event.get());
-          auto call = llvm::cast<llvm::CallBase>(fork->getInst());
-          if (OpenMPModel::isFork(call)) {
-            data.numOpenMPRegions++;
-          }
+    for (auto const &call : calls) {
+      recordFn(data.analyzed, call.call->getCalledFunction());
+    }
+
+    for (auto const &event : events) {
+      if (auto fork = llvm::dyn_cast<ForkEvent>(event.get())) {
+        auto call = llvm::cast<llvm::CallBase>(fork->getInst());
+        if (OpenMPModel::isFork(call)) {
+          data.numOpenMPRegions++;
         }
-        default:
-          break;
       }
     }
   }
@@ -11,23 +11,33 @@ limitations under the License.
 
 #pragma once
 
+#include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/IR/Function.h>
 
 namespace race {
 
+// A function can only be on the stack once (recursion is not traversed),
+// so membership is tracked in a set to make contains constant time
 class CallStack {
   std::vector<const llvm::Function *> stack;
+  llvm::SmallPtrSet<const llvm::Function *, 16> onStack;
 
  public:
-  void push(const llvm::Function *func) { stack.push_back(func); }
+  void push(const llvm::Function *func) {
+    assert(!contains(func) && "function is already on the callstack");
+    stack.push_back(func);
+    onStack.insert(func);
+  }
 
   const llvm::Function *pop() {
     auto f = stack.back();
     stack.pop_back();
+    onStack.erase(f);
     return f;
   }
-  bool contains(const llvm::Function *func) const { return std::find(stack.begin(), stack.end(), func) != stack.end(); }
+  bool contains(const llvm::Function *func) const { return onStack.count(func) > 0; }
   bool isEmpty() { return stack.empty(); }
+  [[nodiscard]] size_t size() const { return stack.size(); }
 };
 
 }  // namespace race
\ No newline at end of file
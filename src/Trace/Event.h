@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "IR/IR.h"
 #include "LanguageModel/RaceModel.h"
+#include "Trace/PointsToSetTable.h"
 
 namespace race {
 
@@ -56,7 +57,10 @@ class MemAccessEvent : public Event {
 
  public:
   [[nodiscard]] const race::MemAccessIR *getIRInst() const override = 0;
-  [[nodiscard]] virtual const std::multiset<const pta::ObjTy *> &getAccessedMemory() const = 0;
+  // The unique objects that may be accessed, ordered by pointer analysis object ID
+  [[nodiscard]] virtual llvm::ArrayRef<const pta::ObjTy *> getAccessedMemory() const = 0;
+  // Events accessing the same set of objects have the same ID, see PointsToSetTable
+  [[nodiscard]] virtual PointsToSetID getPointsToSetID() const = 0;
 
   // Used for llvm style RTTI (isa, dyn_cast, etc.)
   [[nodiscard]] static inline bool classof(const Event *e) { return e->type == Type::Read || e->type == Type::Write; }
@@ -13,9 +13,13 @@ limitations under the License.
 
 using namespace race;
 
-const std::multiset<const pta::ObjTy *> &ReadEventImpl::getAccessedMemory() const { return accessedMemory; }
+llvm::ArrayRef<const pta::ObjTy *> ReadEventImpl::getAccessedMemory() const {
+  return info->thread->program.getPointsToSets().getObjects(accessedMemory);
+}
 
-const std::multiset<const pta::ObjTy *> &WriteEventImpl::getAccessedMemory() const { return accessedMemory; }
+llvm::ArrayRef<const pta::ObjTy *> WriteEventImpl::getAccessedMemory() const {
+  return info->thread->program.getPointsToSets().getObjects(accessedMemory);
+}
 
 std::vector<const pta::CallGraphNodeTy *> ForkEventImpl::getThreadEntry() const {
   auto entryVal = fork->getThreadEntry();
@@ -22,7 +22,7 @@ namespace race {
 
 // This class stores some common info about an event
 // Many events share the same thread/context so to save memory
-// each event impl contains a shared pointer to an EventInfo object
+// each event impl points to an EventInfo object allocated in the thread's arena
 struct EventInfo {
   const ThreadTrace *const thread;
   const pta::ctx *context;
@@ -35,62 +35,66 @@ struct EventInfo {
   EventInfo &operator=(EventInfo &&) = delete;
 };
 
+// Events only hold raw pointers to their IR and EventInfo. The IR is owned by the function summaries
+// kept by the ProgramTrace (or by the thread for IR created while building), so events are small, own nothing and
+// can be allocated in the thread's arena.
+
 class ReadEventImpl : public ReadEvent {
-  std::shared_ptr<EventInfo> info;
-  std::multiset<const pta::ObjTy *> accessedMemory;
+  const EventInfo *info;
+  // interned in the ProgramTrace's PointsToSetTable
+  PointsToSetID accessedMemory;
 
  public:
-  const std::shared_ptr<const ReadIR> read;
+  const ReadIR *const read;
   const EventID id;
 
-  ReadEventImpl(std::shared_ptr<const ReadIR> read, std::shared_ptr<EventInfo> info, EventID id)
-      : info(std::move(info)), accessedMemory({}), read(std::move(read)), id(id) {
-    this->info->thread->program.pta.getPointsTo(this->info->context, this->read->getAccessedValue(), accessedMemory);
-  }
+  ReadEventImpl(const ReadIR *read, const EventInfo *info, PointsToSetID accessedMemory, EventID id)
+      : info(info), accessedMemory(accessedMemory), read(read), id(id) {}
 
   [[nodiscard]] inline EventID getID() const override { return id; }
   [[nodiscard]] inline const pta::ctx *getContext() const override { return info->context; }
   [[nodiscard]] inline const ThreadTrace &getThread() const override { return *info->thread; }
-  [[nodiscard]] inline const race::ReadIR *getIRInst() const override { return read.get(); }
+  [[nodiscard]] inline const race::ReadIR *getIRInst() const override { return read; }
 
-  [[nodiscard]] const std::multiset<const pta::ObjTy *> &getAccessedMemory() const override;
+  [[nodiscard]] llvm::ArrayRef<const pta::ObjTy *> getAccessedMemory() const override;
+  [[nodiscard]] inline PointsToSetID getPointsToSetID() const override { return accessedMemory; }
 };
 
 class WriteEventImpl : public WriteEvent {
-  std::shared_ptr<EventInfo> info;
-  std::multiset<const pta::ObjTy *> accessedMemory;
+  const EventInfo *info;
+  // interned in the ProgramTrace's PointsToSetTable
+  PointsToSetID accessedMemory;
 
  public:
-  const std::shared_ptr<const WriteIR> write;
+  const WriteIR *const write;
   const EventID id;
 
-  WriteEventImpl(std::shared_ptr<const WriteIR> write, std::shared_ptr<EventInfo> info, EventID id)
-      : info(std::move(info)), accessedMemory({}), write(std::move(write)), id(id) {
-    this->info->thread->program.pta.getPointsTo(this->info->context, this->write->getAccessedValue(), accessedMemory);
-  }
+  WriteEventImpl(const WriteIR *write, const EventInfo *info, PointsToSetID accessedMemory, EventID id)
+      : info(info), accessedMemory(accessedMemory), write(write), id(id) {}
 
   [[nodiscard]] inline EventID getID() const override { return id; }
   [[nodiscard]] inline const pta::ctx *getContext() const override { return info->context; }
   [[nodiscard]] inline const ThreadTrace &getThread() const override { return *info->thread; }
-  [[nodiscard]] inline const race::WriteIR *getIRInst() const override { return write.get(); }
+  [[nodiscard]] inline const race::WriteIR *getIRInst() const override { return write; }
 
-  [[nodiscard]] const std::multiset<const pta::ObjTy *> &getAccessedMemory() const override;
+  [[nodiscard]] llvm::ArrayRef<const pta::ObjTy *> getAccessedMemory() const override;
+  [[nodiscard]] inline PointsToSetID getPointsToSetID() const override { return accessedMemory; }
 };
 
 class ForkEventImpl : public ForkEvent {
-  std::shared_ptr<EventInfo> info;
+  const EventInfo *info;
 
  public:
-  const std::shared_ptr<const ForkIR> fork;
+  const ForkIR *const fork;
   const EventID id;
 
-  ForkEventImpl(std::shared_ptr<const ForkIR> fork, std::shared_ptr<EventInfo> info, EventID id)
-      : info(std::move(info)), fork(std::move(fork)), id(id) {}
+  ForkEventImpl(const ForkIR *fork, const EventInfo *info, EventID id)
+      : info(info), fork(fork), id(id) {}
 
   [[nodiscard]] inline EventID getID() const override { return id; }
   [[nodiscard]] inline const pta::ctx *getContext() const override { return info->context; }
   [[nodiscard]] inline const ThreadTrace &getThread() const override { return *info->thread; }
-  [[nodiscard]] inline const race::ForkIR *getIRInst() const override { return fork.get(); }
+  [[nodiscard]] inline const race::ForkIR *getIRInst() const override { return fork; }
 
   [[nodiscard]] std::vector<const pta::ObjTy *> getThreadHandle() const override {
     // TODO
@@ -100,26 +104,25 @@ class ForkEventImpl : public ForkEvent {
 };
 
 class JoinEventImpl : public JoinEvent {
-  std::shared_ptr<EventInfo> info;
+  const EventInfo *info;
 
  public:
-  const std::shared_ptr<const JoinIR> join;
+  const JoinIR *const join;
   const EventID id;
 
   // the corresponding fork event if it is known
   std::optional<const ForkEvent *> forkEvent;
 
-  JoinEventImpl(std::shared_ptr<const JoinIR> join, std::shared_ptr<EventInfo> info, EventID id)
-      : info(std::move(info)), join(std::move(join)), id(id), forkEvent(std::nullopt) {}
+  JoinEventImpl(const JoinIR *join, const EventInfo *info, EventID id)
+      : info(info), join(join), id(id), forkEvent(std::nullopt) {}
 
-  JoinEventImpl(std::shared_ptr<const JoinIR> join, std::shared_ptr<EventInfo> info, EventID id,
-                const ForkEvent *forkEvent)
-      : info(std::move(info)), join(std::move(join)), id(id), forkEvent(forkEvent) {}
+  JoinEventImpl(const JoinIR *join, const EventInfo *info, EventID id, const ForkEvent *forkEvent)
+      : info(info), join(join), id(id), forkEvent(forkEvent) {}
 
   [[nodiscard]] inline EventID getID() const override { return id; }
   [[nodiscard]] inline const pta::ctx *getContext() const override { return info->context; }
   [[nodiscard]] inline const ThreadTrace &getThread() const override { return *info->thread; }
-  [[nodiscard]] inline const race::JoinIR *getIRInst() const override { return join.get(); }
+  [[nodiscard]] inline const race::JoinIR *getIRInst() const override { return join; }
 
   [[nodiscard]] std::optional<const ForkEvent *> getForkEvent() const override { return forkEvent; }
   [[nodiscard]] std::vector<const pta::ObjTy *> getThreadHandle() const override {
@@ -129,19 +132,19 @@ class JoinEventImpl : public JoinEvent {
 };
 
 class LockEventImpl : public LockEvent {
-  std::shared_ptr<EventInfo> info;
+  const EventInfo *info;
 
  public:
-  const std::shared_ptr<const LockIR> lock;
+  const LockIR *const lock;
   const EventID id;
 
-  LockEventImpl(std::shared_ptr<const LockIR> lock, std::shared_ptr<EventInfo> info, EventID id)
-      : info(std::move(info)), lock(std::move(lock)), id(id) {}
+  LockEventImpl(const LockIR *lock, const EventInfo *info, EventID id)
+      : info(info), lock(lock), id(id) {}
 
   [[nodiscard]] inline EventID getID() const override { return id; }
   [[nodiscard]] inline const pta::ctx *getContext() const override { return info->context; }
   [[nodiscard]] inline const ThreadTrace &getThread() const override { return *info->thread; }
-  [[nodiscard]] inline const race::LockIR *getIRInst() const override { return lock.get(); }
+  [[nodiscard]] inline const race::LockIR *getIRInst() const override { return lock; }
 
   [[nodiscard]] std::vector<const pta::ObjTy *> getLockObj() const override {
     // TODO
@@ -150,19 +153,19 @@ class LockEventImpl : public LockEvent {
 };
 
 class UnlockEventImpl : public UnlockEvent {
-  std::shared_ptr<EventInfo> info;
+  const EventInfo *info;
 
  public:
-  const std::shared_ptr<const UnlockIR> unlock;
+  const UnlockIR *const unlock;
   const EventID id;
 
-  UnlockEventImpl(std::shared_ptr<const UnlockIR> unlock, std::shared_ptr<EventInfo> info, EventID id)
-      : info(std::move(info)), unlock(std::move(unlock)), id(id) {}
+  UnlockEventImpl(const UnlockIR *unlock, const EventInfo *info, EventID id)
+      : info(info), unlock(unlock), id(id) {}
 
   [[nodiscard]] inline EventID getID() const override { return id; }
   [[nodiscard]] inline const pta::ctx *getContext() const override { return info->context; }
   [[nodiscard]] inline const ThreadTrace &getThread() const override { return *info->thread; }
-  [[nodiscard]] inline const race::UnlockIR *getIRInst() const override { return unlock.get(); }
+  [[nodiscard]] inline const race::UnlockIR *getIRInst() const override { return unlock; }
 
   [[nodiscard]] std::vector<const pta::ObjTy *> getLockObj() const override {
     // TODO
@@ -171,71 +174,71 @@ class UnlockEventImpl : public UnlockEvent {
 };
 
 class BarrierEventImpl : public BarrierEvent {
-  std::shared_ptr<EventInfo> info;
+  const EventInfo *info;
 
  public:
-  const std::shared_ptr<const BarrierIR> barrier;
+  const BarrierIR *const barrier;
   const EventID id;
 
-  BarrierEventImpl(std::shared_ptr<const BarrierIR> barrier, std::shared_ptr<EventInfo> info, EventID id)
-      : info(std::move(info)), barrier(std::move(barrier)), id(id) {}
+  BarrierEventImpl(const BarrierIR *barrier, const EventInfo *info, EventID id)
+      : info(info), barrier(barrier), id(id) {}
 
   [[nodiscard]] inline EventID getID() const override { return id; }
   [[nodiscard]] inline const pta::ctx *getContext() const override { return info->context; }
   [[nodiscard]] inline const ThreadTrace &getThread() const override { return *info->thread; }
-  [[nodiscard]] inline const race::BarrierIR *getIRInst() const override { return barrier.get(); }
+  [[nodiscard]] inline const race::BarrierIR *getIRInst() const override { return barrier; }
 };
 
 class EnterCallEventImpl : public EnterCallEvent {
-  std::shared_ptr<EventInfo> info;
+  const EventInfo *info;
 
  public:
-  const std::shared_ptr<const CallIR> call;
+  const CallIR *const call;
   const EventID id;
 
-  EnterCallEventImpl(std::shared_ptr<const CallIR> call, std::shared_ptr<EventInfo> info, EventID id)
-      : info(std::move(info)), call(std::move(call)), id(id) {}
+  EnterCallEventImpl(const CallIR *call, const EventInfo *info, EventID id)
+      : info(info), call(call), id(id) {}
 
   [[nodiscard]] inline EventID getID() const override { return id; }
   [[nodiscard]] inline const pta::ctx *getContext() const override { return info->context; }
   [[nodiscard]] inline const ThreadTrace &getThread() const override { return *info->thread; }
-  [[nodiscard]] inline const race::CallIR *getIRInst() const override { return call.get(); }
+  [[nodiscard]] inline const race::CallIR *getIRInst() const override { return call; }
 
   [[nodiscard]] const llvm::Function *getCalledFunction() const override { return call->getCalledFunction(); }
 };
 
 class LeaveCallEventImpl : public LeaveCallEvent {
-  std::shared_ptr<EventInfo> info;
+  const EventInfo *info;
 
  public:
-  const std::shared_ptr<const CallIR> call;
+  const CallIR *const call;
   const EventID id;
 
-  LeaveCallEventImpl(std::shared_ptr<const CallIR> call, std::shared_ptr<EventInfo> info, EventID id)
-      : info(std::move(info)), call(std::move(call)), id(id) {}
+  LeaveCallEventImpl(const CallIR *call, const EventInfo *info, EventID id)
+      : info(info), call(call), id(id) {}
 
   [[nodiscard]] inline EventID getID() const override { return id; }
   [[nodiscard]] inline const pta::ctx *getContext() const override { return info->context; }
   [[nodiscard]] inline const ThreadTrace &getThread() const override { return *info->thread; }
-  [[nodiscard]] inline const race::CallIR *getIRInst() const override { return call.get(); }
+  [[nodiscard]] inline const race::CallIR *getIRInst() const override { return call; }
 
   [[nodiscard]] const llvm::Function *getCalledFunction() const override { return call->getCalledFunction(); }
 };
 
 class ExternCallEventImpl : public ExternCallEvent {
-  std::shared_ptr<EventInfo> info;
+  const EventInfo *info;
 
  public:
-  const std::shared_ptr<const CallIR> call;
+  const CallIR *const call;
   const EventID id;
 
-  ExternCallEventImpl(std::shared_ptr<const CallIR> call, std::shared_ptr<EventInfo> info, EventID id)
-      : info(std::move(info)), call(std::move(call)), id(id) {}
+  ExternCallEventImpl(const CallIR *call, const EventInfo *info, EventID id)
+      : info(info), call(call), id(id) {}
 
   [[nodiscard]] inline EventID getID() const override { return id; }
   [[nodiscard]] inline const pta::ctx *getContext() const override { return info->context; }
   [[nodiscard]] inline const ThreadTrace &getThread() const override { return *info->thread; }
-  [[nodiscard]] inline const race::CallIR *getIRInst() const override { return call.get(); }
+  [[nodiscard]] inline const race::CallIR *getIRInst() const override { return call; }
 
   [[nodiscard]] const llvm::Function *getCalledFunction() const override {
     return call->getInst()->getCalledFunction();
@@ -0,0 +1,61 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "Trace/PointsToSetTable.h"
+
+#include <algorithm>
+
+using namespace race;
+
+namespace {
+
+bool isThreadLocal(const pta::ObjTy *obj) {
+  auto const global = llvm::dyn_cast_or_null<llvm::GlobalVariable>(obj->getValue());
+  return global && global->isThreadLocal();
+}
+
+}  // namespace
+
+PointsToSetTable::PointsToSetTable() {
+  auto const id = intern({});
+  assert(id == EMPTY && "the empty set should be interned first");
+  (void)id;
+}
+
+PointsToSetID PointsToSetTable::intern(const std::multiset<const pta::ObjTy *> &pts) {
+  std::vector<const pta::ObjTy *> objects(pts.begin(), pts.end());
+  // Pointer order can change from run to run, so order by pointer analysis ID instead
+  std::sort(objects.begin(), objects.end(),
+            [](const pta::ObjTy *lhs, const pta::ObjTy *rhs) { return lhs->getObjectID() < rhs->getObjectID(); });
+  objects.erase(std::unique(objects.begin(), objects.end()), objects.end());
+
+  auto const [it, inserted] = ids.emplace(std::move(objects), static_cast<PointsToSetID>(sets.size()));
+  if (!inserted) {
+    return it->second;
+  }
+
+  PointsToSet set{&it->first, {}};
+  for (auto const obj : it->first) {
+    if (!isThreadLocal(obj)) {
+      set.nonThreadLocal.set(obj->getObjectID());
+    }
+  }
+  sets.push_back(std::move(set));
+  return it->second;
+}
+
+bool PointsToSetTable::sharesNonThreadLocal(PointsToSetID lhs, PointsToSetID rhs) const {
+  auto const &lhsObjs = sets.at(lhs).nonThreadLocal;
+  if (lhs == rhs) {
+    return !lhsObjs.empty();
+  }
+  return lhsObjs.intersects(sets.at(rhs).nonThreadLocal);
+}
@@ -0,0 +1,60 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/SparseBitVector.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "LanguageModel/RaceModel.h"
+
+namespace race {
+
+using PointsToSetID = uint32_t;
+
+// Interned points-to sets of the memory accessed by read/write events
+// Identical sets are stored once and share one dense ID, so events only need to store the ID.
+// ID 0 is always the empty set.
+// Interning is not thread safe, callers building traces in parallel must hold a lock while interning.
+class PointsToSetTable {
+  struct PointsToSet {
+    // unique objects ordered by pointer analysis object ID, owned by the key of the set in ids
+    const std::vector<const pta::ObjTy *> *objects;
+    // pointer analysis object IDs of the objects in this set that are not thread local
+    llvm::SparseBitVector<> nonThreadLocal;
+  };
+
+  std::vector<PointsToSet> sets;
+  std::map<std::vector<const pta::ObjTy *>, PointsToSetID> ids;
+
+ public:
+  static constexpr PointsToSetID EMPTY = 0;
+
+  PointsToSetTable();
+
+  // Get the ID of the set containing the objects in pts, adding the set to the table if it is new
+  PointsToSetID intern(const std::multiset<const pta::ObjTy *> &pts);
+
+  // The unique objects in set id, ordered by pointer analysis object ID
+  [[nodiscard]] llvm::ArrayRef<const pta::ObjTy *> getObjects(PointsToSetID id) const { return *sets.at(id).objects; }
+
+  // Return true if both sets contain the same object and that object is not thread local
+  [[nodiscard]] bool sharesNonThreadLocal(PointsToSetID lhs, PointsToSetID rhs) const;
+
+  // Number of unique sets, including the empty set
+  [[nodiscard]] size_t size() const { return sets.size(); }
+};
+
+}  // namespace race
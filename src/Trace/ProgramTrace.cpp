@@ -11,42 +11,205 @@ limitations under the License.
 
 #include "ProgramTrace.h"
 
+#include <condition_variable>
+#include <thread>
+
 #include "PreProcessing/PreProcessing.h"
 #include "Trace/Event.h"
 
 using namespace race;
 
-ProgramTrace::ProgramTrace(llvm::Module *module, llvm::StringRef entryName) : module(module) {
+ProgramTrace::ProgramTrace(llvm::Module *module, llvm::StringRef entryName, unsigned int numWorkers,
+                           TraceBudget budget, bool skipThreadPrivate, bool elideCallEvents,
+                           bool shareCallSegments)
+    : module(module) {
   // Run preprocessing on module
   preprocess(*module);
 
+  if (skipThreadPrivate) {
+    escape = std::make_unique<EscapeAnalysis>(*module);
+    summaries = FunctionSummaryBuilder(escape.get());
+  }
+
   // Run pointer analysis
+  pta.setNumWorkers(std::max(numWorkers, 1u));
   pta.analyze(module, entryName);
 
-  TraceBuildState state;
+  SharedBuildState shared(summaries, pointsToSets, std::max(numWorkers, 1u), budget, elideCallEvents,
+                          shareCallSegments);
+  TraceBuildState state(shared);
 
   // build all threads starting from this main func
   auto const mainEntry = pta::GT::getEntryNode(pta.getCallGraph());
   // Program trace needs to hold a unique ptr to the entry thread
   mainThread = std::make_unique<ThreadTrace>(*this, mainEntry, state);
 
+  // Build the threads that were deferred while building the main thread, and their children
+  buildDeferredThreads(std::move(state.deferredThreads), shared);
+
+  collectThreads();
+  buildForkIndex();
+  classifyThreads();
+}
+
+void ProgramTrace::buildDeferredThreads(std::vector<DeferredThread> deferred, SharedBuildState &shared) {
+  // Workers take threads from a shared queue. Building a thread may defer more threads, which are added to the queue.
+  // Workers finish once the queue is empty and no other worker can add to it.
+  std::mutex queueLock;
+  std::condition_variable queueChanged;
+  std::deque<DeferredThread> queue(deferred.begin(), deferred.end());
+  size_t active = 0;
+
+  auto const worker = [&]() {
+    std::unique_lock<std::mutex> lock(queueLock);
+    while (true) {
+      queueChanged.wait(lock, [&]() { return !queue.empty() || active == 0; });
+      if (queue.empty()) return;
+
+      auto const next = queue.front();
+      queue.pop_front();
+      ++active;
+      lock.unlock();
+
+      TraceBuildState state(shared);
+      next.thread->buildEventTrace(next.entry, pta, state);
+
+      lock.lock();
+      --active;
+      queue.insert(queue.end(), state.deferredThreads.begin(), state.deferredThreads.end());
+      queueChanged.notify_all();
+    }
+  };
+
+  if (queue.empty()) return;
+
+  std::vector<std::thread> workers;
+  workers.reserve(shared.numWorkers);
+  for (unsigned int i = 0; i < shared.numWorkers; ++i) {
+    workers.emplace_back(worker);
+  }
+  for (auto &thread : workers) {
+    thread.join();
+  }
+}
+
+void ProgramTrace::collectThreads() {
   // Traverse all child threads and build a flat list of all threads
-  std::deque<const ThreadTrace *> worklist;
+  // IDs are assigned in this (depth first) order so they do not depend on the order threads were built in
+  std::vector<ThreadTrace *> worklist;
   worklist.push_back(mainThread.get());
 
   while (!worklist.empty()) {
     auto const currentThread = worklist.back();
     worklist.pop_back();
 
+    currentThread->id = threads.size();
     threads.push_back(currentThread);
 
-    auto const &childThreads = currentThread->getChildThreads();
+    auto const &childThreads = currentThread->childThreads;
     for (auto it = childThreads.rbegin(), end = childThreads.rend(); it != end; ++it) {
       worklist.push_back(it->get());
     }
   }
 }
 
+void ProgramTrace::buildForkIndex() {
+  for (auto const &thread : threads) {
+    // a fork with multiple possible entries spawns one thread per entry, keep the first
+    if (thread->spawnSite.has_value()) {
+      forkedThreads.emplace(thread->spawnSite.value(), thread);
+    }
+
+    for (auto const fork : thread->getForkEvents()) {
+      handleForks[fork->getIRInst()->getThreadHandle()].push_back(fork);
+    }
+  }
+}
+
+namespace {
+
+// Threads spawned by OpenMP, directly or through an ancestor, are treated differently depending on which team and
+// fork they belong to, so they are never considered isomorphic to another thread
+bool hasOpenMPSpawn(const ThreadTrace *thread) {
+  while (thread->spawnSite.has_value()) {
+    auto const spawn = thread->spawnSite.value();
+    auto const type = spawn->getIRType();
+    if (type == IR::Type::OpenMPFork || type == IR::Type::OpenMPForkTeams || type == IR::Type::OpenMPTaskFork) {
+      return true;
+    }
+    thread = &spawn->getThread();
+  }
+  return false;
+}
+
+// The event structure of a thread: the IR of each event and the points-to set of each access,
+// followed by the (at, begin, end) of each shared call segment
+struct ThreadFingerprint {
+  std::vector<std::tuple<Event::Type, const IR *, PointsToSetID>> events;
+  std::vector<std::tuple<EventID, EventID, EventID>> segmentRefs;
+
+  bool operator<(const ThreadFingerprint &other) const {
+    return std::tie(events, segmentRefs) < std::tie(other.events, other.segmentRefs);
+  }
+};
+
+ThreadFingerprint getFingerprint(const ThreadTrace &thread) {
+  ThreadFingerprint fingerprint;
+  fingerprint.events.reserve(thread.getEvents().size());
+  for (auto const &event : thread.getEvents()) {
+    PointsToSetID pts = PointsToSetTable::EMPTY;
+    if (auto const access = llvm::dyn_cast<MemAccessEvent>(event.get())) {
+      pts = access->getPointsToSetID();
+    }
+    fingerprint.events.emplace_back(event->type, event->getIRInst(), pts);
+  }
+  for (auto const &ref : thread.getSegmentRefs()) {
+    fingerprint.segmentRefs.emplace_back(ref.at, ref.begin, ref.end);
+  }
+  return fingerprint;
+}
+
+}  // namespace
+
+void ProgramTrace::classifyThreads() {
+  std::map<ThreadFingerprint, ThreadClassID> classes;
+  threadClasses.reserve(threads.size());
+  for (auto const thread : threads) {
+    auto threadClass = classMultiplicity.size();
+    // The main thread has no spawn site and is the only thread starting at the entry, so it has its own class
+    if (thread->spawnSite.has_value() && !hasOpenMPSpawn(thread)) {
+      threadClass = classes.emplace(getFingerprint(*thread), threadClass).first->second;
+    }
+
+    if (threadClass == classMultiplicity.size()) {
+      classMultiplicity.push_back(0);
+    }
+    classMultiplicity.at(threadClass)++;
+    threadClasses.push_back(threadClass);
+  }
+}
+
+bool ProgramTrace::isTruncated() const {
+  return std::any_of(threads.begin(), threads.end(),
+                     [](const ThreadTrace *thread) { return !thread->getTruncations().empty(); });
+}
+
+const ThreadTrace *ProgramTrace::getForkedThread(const ForkEvent *fork) const {
+  // cppcheck-suppress stlIfFind
+  if (auto it = forkedThreads.find(fork); it != forkedThreads.end()) {
+    return it->second;
+  }
+  return nullptr;
+}
+
+llvm::ArrayRef<const ForkEvent *> ProgramTrace::getForksWithHandle(const llvm::Value *handle) const {
+  // cppcheck-suppress stlIfFind
+  if (auto it = handleForks.find(handle); it != handleForks.end()) {
+    return it->second;
+  }
+  return {};
+}
+
 llvm::raw_ostream &race::operator<<(llvm::raw_ostream &os, const ProgramTrace &trace) {
   os << "===== Program Trace =====\n";
 
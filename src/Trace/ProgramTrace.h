@@ -13,12 +13,16 @@ limitations under the License.
 
 #include <IR/Builder.h>
 
+#include <llvm/ADT/ArrayRef.h>
+
+#include <mutex>
 #include <vector>
 
 #include "IR/IRImpls.h"
 #include "LanguageModel/RaceModel.h"
 #include "ThreadTrace.h"
 #include "Trace/Event.h"
+#include "Trace/PointsToSetTable.h"
 
 namespace race {
 
@@ -64,27 +68,112 @@ struct OpenMPState {
   std::vector<UnjoinedTask> unjoinedTasks;
 };
 
+// Limits on the size of each thread trace, so pathological inputs (very deep or very long call chains)
+// use bounded memory. Where a thread is cut short is recorded in ThreadTrace::getTruncations
+struct TraceBudget {
+  // Calls are not traversed once the call stack is this deep (0 means no limit)
+  size_t maxCallDepth = 0;
+  // Traversal of a thread stops once it has this many events (0 means no limit)
+  // Calls that are still open get their CallEnd event (unless call events are elided), so a thread may end slightly
+  // over the limit
+  size_t maxThreadEvents = 0;
+};
+
+// State shared by every thread while building the ProgramTrace
+// Threads may be built in parallel, so lock must be held while using any of these
+struct SharedBuildState {
+  std::mutex lock;
+
+  // Cached function summaries, owned by the ProgramTrace because events point to their IR
+  FunctionSummaryBuilder &builder;
+
+  // Points-to sets interned by the ProgramTrace, so events only store a set ID
+  PointsToSetTable &pointsToSets;
+  // Interned points-to set of each accessed value, computed once per context and value
+  std::map<std::pair<const pta::ctx *, const llvm::Value *>, PointsToSetID> accessedMemory;
+
+  // Number of threads used to build thread traces. Threads are only built later in parallel if this is more than 1
+  unsigned int numWorkers = 1;
+
+  // Never changed while building, so they can be read without holding lock
+  const TraceBudget budget;
+  // Leave Call/CallEnd events out of the trace, calls are only recorded in ThreadTrace::getCalls
+  const bool elideCallEvents;
+  // Repeated calls to a function in the same context refer to the events of the first call, see CallSegmentRef
+  const bool shareCallSegments;
+
+  SharedBuildState(FunctionSummaryBuilder &builder, PointsToSetTable &pointsToSets, unsigned int numWorkers,
+                   TraceBudget budget, bool elideCallEvents, bool shareCallSegments)
+      : builder(builder),
+        pointsToSets(pointsToSets),
+        numWorkers(numWorkers),
+        budget(budget),
+        elideCallEvents(elideCallEvents),
+        shareCallSegments(shareCallSegments) {}
+};
+
+// A spawned thread whose events are built after the thread that spawned it
+struct DeferredThread {
+  ThreadTrace *thread;
+  const pta::CallGraphNodeTy *entry;
+};
+
 // all included states are ONLY used when building ProgramTrace/ThreadTrace
+// Each thread built in parallel gets its own TraceBuildState, threads built inline share their parent's
 struct TraceBuildState {
-  // Cached function summaries
-  FunctionSummaryBuilder builder;
-
-  // the counter of thread id: since we are constructing ThreadTrace while building events,
-  // pState.threads.size() will be updated after finishing the construction, we need such a counter
-  ThreadID currentTID = 0;
+  SharedBuildState &shared;
 
   // When set, skip traversing until this instruction is reached
   const llvm::Instruction *skipUntil = nullptr;
 
   // Track state specific to OpenMP
   OpenMPState openmp;
+
+  // Threads spawned while building that still need to be built
+  std::vector<DeferredThread> deferredThreads;
+
+  explicit TraceBuildState(SharedBuildState &shared) : shared(shared) {}
 };
 
+using ThreadClassID = size_t;
+
 class ProgramTrace {
   llvm::Module *module;
+
+  // Only set if thread private accesses are left out of the trace
+  std::unique_ptr<EscapeAnalysis> escape;
+
+  // Events refer to the IR in these summaries and to these points-to sets instead of each holding a copy,
+  // so both are kept for the lifetime of the trace
+  FunctionSummaryBuilder summaries;
+  PointsToSetTable pointsToSets;
+
   std::unique_ptr<ThreadTrace> mainThread;
   std::vector<const ThreadTrace *> threads;
 
+  // Fork/join matching index, built once after all threads are constructed
+  // fork event -> the first thread spawned by that fork
+  std::map<const ForkEvent *, const ThreadTrace *> forkedThreads;
+  // thread handle -> fork events using that handle, in thread and event order
+  std::map<const llvm::Value *, std::vector<const ForkEvent *>> handleForks;
+
+  void buildForkIndex();
+
+  // Isomorphic thread classes, see getThreadClass
+  // thread ID -> class of that thread
+  std::vector<ThreadClassID> threadClasses;
+  // class -> number of threads in that class
+  std::vector<size_t> classMultiplicity;
+
+  // Group isomorphic threads into classes, once every thread has its ID
+  void classifyThreads();
+
+  // Build deferred threads (and any threads they defer) on up to numWorkers threads
+  void buildDeferredThreads(std::vector<DeferredThread> deferred, SharedBuildState &shared);
+
+  // Flatten the thread tree into threads, assigning thread IDs in depth first order
+  void collectThreads();
+
   friend class ThreadTrace;
 
  public:
@@ -92,12 +181,49 @@ class ProgramTrace {
 
   [[nodiscard]] inline const std::vector<const ThreadTrace *> &getThreads() const { return threads; }
 
+  // The escape analysis used to leave out thread private accesses, or nullptr if they were not left out
+  [[nodiscard]] const EscapeAnalysis *getEscapeAnalysis() const { return escape.get(); }
+
+  // True if any thread trace was cut short by the TraceBudget
+  [[nodiscard]] bool isTruncated() const;
+
+  // The points-to sets accessed by read/write events
+  [[nodiscard]] inline const PointsToSetTable &getPointsToSets() const { return pointsToSets; }
+
+  // Threads not spawned by OpenMP that have the same events, with the same IR and points-to sets, are isomorphic and
+  // share a class. Accesses from any two threads of a pair of classes are decided the same way by every per-access
+  // check, so race checking only checks accesses once per pair of classes and sync intervals.
+  [[nodiscard]] ThreadClassID getThreadClass(ThreadID tid) const { return threadClasses.at(tid); }
+
+  // Number of threads in class
+  [[nodiscard]] size_t getClassMultiplicity(ThreadClassID threadClass) const {
+    return classMultiplicity.at(threadClass);
+  }
+
+  [[nodiscard]] size_t numThreadClasses() const { return classMultiplicity.size(); }
+
+  // Get the thread spawned by fork, or nullptr if no thread was built for it
+  [[nodiscard]] const ThreadTrace *getForkedThread(const ForkEvent *fork) const;
+
+  // Get all fork events whose thread handle is handle, in thread and event order
+  [[nodiscard]] llvm::ArrayRef<const ForkEvent *> getForksWithHandle(const llvm::Value *handle) const;
+
   [[nodiscard]] const Event *getEvent(ThreadID tid, EventID eid) { return threads.at(tid)->getEvent(eid); }
 
   // Get the module after preprocessing has been run
   [[nodiscard]] const Module &getModule() const { return *module; }
 
-  explicit ProgramTrace(llvm::Module *module, llvm::StringRef entryName = "main");
+  // Pointer analysis propagates copy edges and spawned threads are built on up to numWorkers threads.
+  // Neither the points-to sets nor thread IDs depend on the number of workers.
+  // If skipThreadPrivate is set, loads/stores of objects that never escape their function (see EscapeAnalysis)
+  // are left out of the trace, as they cannot race
+  // If elideCallEvents is set, threads only contain memory and sync events. Calls are still recorded out of band,
+  // see ThreadTrace::getCalls
+  // If shareCallSegments is set, a thread traverses each function in each context once. Later calls to it only get an
+  // EnterCall event that refers to the events of the first call, see ThreadTrace::getSegmentRefs
+  explicit ProgramTrace(llvm::Module *module, llvm::StringRef entryName = "main", unsigned int numWorkers = 1,
+                        TraceBudget budget = TraceBudget(), bool skipThreadPrivate = false,
+                        bool elideCallEvents = false, bool shareCallSegments = false);
   ~ProgramTrace() = default;
   ProgramTrace(const ProgramTrace &) = delete;
   ProgramTrace(ProgramTrace &&) = delete;  // Need to update threads because
@@ -11,6 +11,8 @@ limitations under the License.
 
 #include "Trace/ThreadTrace.h"
 
+#include <map>
+
 #include "EventImpl.h"
 #include "IR/IRImpls.h"
 #include "Trace/CallStack.h"
@@ -20,16 +22,39 @@ using namespace race;
 
 namespace {
 
+// The storage of the thread trace being built
+// Events are allocated in the thread's arena and appended to its list of events
+struct TraceStorage {
+  llvm::BumpPtrAllocator &arena;
+  std::vector<EventPtr> &events;
+  std::vector<std::shared_ptr<const IR>> &syntheticIR;
+  std::vector<TraceTruncation> &truncations;
+  std::vector<CallInterval> &calls;
+  std::vector<CallSegmentRef> &segmentRefs;
+
+  [[nodiscard]] EventID nextID() const { return events.size(); }
+
+  template <typename EventImplTy, typename... Args>
+  const EventImplTy *append(Args &&...args) {
+    auto const event = new (arena.Allocate<EventImplTy>()) EventImplTy(std::forward<Args>(args)...);
+    events.emplace_back(event);
+    return event;
+  }
+
+  const EventInfo *newEventInfo(const ThreadTrace &thread, const pta::ctx *context) {
+    return new (arena.Allocate<EventInfo>()) EventInfo(thread, context);
+  }
+};
+
 // all tasks in state.unjoinedTasks should be joined when any of the following occur:
 // 1. a barrier is encountered (from anywhere, not just after single)
 // 2. taskwait is encountered (TODO)
 // 3. the end of the parallel region is encountered.
-void insertTaskJoins(std::vector<std::unique_ptr<const Event>> &events, TraceBuildState &state,
-                     std::shared_ptr<struct EventInfo> &einfo) {
+void insertTaskJoins(TraceStorage &storage, TraceBuildState &state, const EventInfo *einfo) {
   for (auto const &task : state.openmp.unjoinedTasks) {
-    auto taskJoin = std::make_shared<OpenMPTaskJoin>(task.forkIR);
-    std::shared_ptr<const JoinIR> join(taskJoin, llvm::cast<JoinIR>(taskJoin.get()));
-    events.push_back(std::make_unique<const JoinEventImpl>(join, einfo, events.size(), task.forkEvent));
+    auto taskJoin = std::make_shared<const OpenMPTaskJoin>(task.forkIR);
+    storage.syntheticIR.push_back(taskJoin);
+    storage.append<JoinEventImpl>(taskJoin.get(), einfo, storage.nextID(), task.forkEvent);
   }
   state.openmp.unjoinedTasks.clear();
 }
@@ -47,6 +72,14 @@ bool isOpenMPMasterThread(const ThreadTrace &thread) {
   return ompThread->isForkingMaster();
 }
 
+// return true if thread or any thread it was spawned from is an OpenMP thread
+bool hasOpenMPSpawn(const ThreadTrace &thread) {
+  for (auto current = &thread; current->spawnSite.has_value(); current = &current->spawnSite.value()->getThread()) {
+    if (isOpenMPThread(*current)) return true;
+  }
+  return false;
+}
+
 // handle omp single/master events and other omp events
 // return true if the current instruction should be skipped
 bool handleOMPEvents(const CallIR *callIR, TraceBuildState &state, bool isMasterThread) {
@@ -104,79 +137,235 @@ bool shouldSkipIR(const std::shared_ptr<const IR> &ir, TraceBuildState &state) {
   return false;
 }
 
+// Get the interned points-to set of value in context, computing it only the first time it is requested
+PointsToSetID getAccessedMemory(const pta::ctx *context, const llvm::Value *value, const pta::PTA &pta,
+                                TraceBuildState &state) {
+  std::lock_guard<std::mutex> guard(state.shared.lock);
+  auto [it, inserted] = state.shared.accessedMemory.try_emplace({context, value}, PointsToSetTable::EMPTY);
+  if (inserted) {
+    std::multiset<const pta::ObjTy *> pts;
+    pta.getPointsTo(context, value, pts);
+    it->second = state.shared.pointsToSets.intern(pts);
+  }
+  return it->second;
+}
+
+const pta::ctx *evolveContext(const pta::ctx *context, const llvm::Instruction *inst, TraceBuildState &state) {
+  std::lock_guard<std::mutex> guard(state.shared.lock);
+  return pta::CT::contextEvolve(context, inst);
+}
+
+std::shared_ptr<const FunctionSummary> getFunctionSummary(const llvm::Function *func, TraceBuildState &state) {
+  std::lock_guard<std::mutex> guard(state.shared.lock);
+  return state.shared.builder.getFunctionSummary(func);
+}
+
+// Resolving entries evolves the calling context, which interns new contexts in the pointer analysis
+std::vector<const pta::CallGraphNodeTy *> getThreadEntry(const ForkEvent *fork, TraceBuildState &state) {
+  std::lock_guard<std::mutex> guard(state.shared.lock);
+  return fork->getThreadEntry();
+}
+
+// Threads spawned outside of OpenMP only depend on their entry, so they can be built after the parent.
+// OpenMP threads must be built in place because the parent's traversal depends on the OpenMP state they leave
+// behind (unjoined tasks, master regions).
+bool canBuildLater(const ForkEvent *spawningEvent, const TraceBuildState &state) {
+  if (state.shared.numWorkers <= 1) return false;
+
+  auto const type = spawningEvent->getIRType();
+  if (type == IR::Type::OpenMPFork || type == IR::Type::OpenMPForkTeams || type == IR::Type::OpenMPTaskFork) {
+    return false;
+  }
+
+  auto const &openmp = state.openmp;
+  return !openmp.inTeamsRegion() && !openmp.inSingle && openmp.unjoinedTasks.empty() && !openmp.currentMasterStart &&
+         !state.skipUntil;
+}
+
 bool isOpenMPTeamSpecific(const IR *ir) {
   auto const type = ir->type;
   return type == IR::Type::OpenMPBarrier || type == IR::Type::OpenMPCriticalStart ||
          type == IR::Type::OpenMPCriticalEnd || type == IR::Type::OpenMPSetLock || type == IR::Type::OpenMPUnsetLock;
 }
 
-// Called recursively to build list of events and thread traces
-// node      - the current callgraph node to traverse
+// A function being traversed, on the explicit stack used by traverseThread
+struct CallFrame {
+  const pta::CallGraphNodeTy *node;
+  std::shared_ptr<const FunctionSummary> summary;
+  const EventInfo *einfo;
+  // index of the next IR in summary to traverse
+  size_t next;
+  // the call that entered this function and the info of its events, nullptr for the thread entry
+  const CallIR *caller;
+  const EventInfo *callerInfo;
+  // index of the CallInterval of caller, unset for the thread entry
+  std::optional<size_t> callInterval;
+  // whether the events of this call can be shared with later calls of node, see CallSegmentRef
+  bool shareable;
+  // number of frames this call needed, counting its own
+  size_t height;
+};
+
+// The events made by the first call of a function in some context, shared with later calls of it
+struct CallSegment {
+  EventID begin;
+  EventID end;
+  // see CallFrame::height
+  size_t height;
+};
+
+// Calls are only shared outside of OpenMP, where the events made by a call depend on the OpenMP state of the thread
+bool canShareCalls(const ThreadTrace &thread, const TraceBuildState &state) {
+  if (!state.shared.shareCallSegments || hasOpenMPSpawn(thread)) return false;
+
+  auto const &openmp = state.openmp;
+  return !openmp.inTeamsRegion() && !openmp.inSingle && openmp.unjoinedTasks.empty() && !openmp.currentMasterStart &&
+         !state.skipUntil;
+}
+
+// Build the list of events and thread traces of a thread
+// The call graph is traversed with an explicit stack so deep call chains cannot overflow the stack of the tool itself
+// entry     - the callgraph node the thread starts from
 // thread    - the thread trace being built
-// callstack - callstack used to prevent recursion
 // pta       - pointer analysis used to find next nodes in call graph
-// events    - list of events to append newly created events to
+// storage   - storage of the thread trace to append newly created events and truncations to
 // threads   - list of threads to append and newly created threads to
 // state     - used to track data across the construction of the entire program trace
-void traverseCallNode(const pta::CallGraphNodeTy *node, ThreadTrace &thread, CallStack &callstack, const pta::PTA &pta,
-                      std::vector<std::unique_ptr<const Event>> &events,
-                      std::vector<std::unique_ptr<const ThreadTrace>> &threads, TraceBuildState &state) {
-  auto func = node->getTargetFun()->getFunction();
-  if (callstack.contains(func)) {
-    // prevent recursion
-    return;
-  }
+void traverseThread(const pta::CallGraphNodeTy *entry, ThreadTrace &thread, const pta::PTA &pta, TraceStorage &storage,
+                    std::vector<std::unique_ptr<ThreadTrace>> &threads, TraceBuildState &state) {
+  auto const &budget = state.shared.budget;
+  auto const keepCallEvents = !state.shared.elideCallEvents;
+  // used to prevent recursion
+  CallStack callstack;
+  std::vector<CallFrame> frames;
+  // the shared events of each function and context, only used if canShareCalls
+  std::map<const pta::CallGraphNodeTy *, CallSegment> segments;
+
+  // Start traversing node, called from caller. Returns false if node is already being traversed (recursion)
+  auto const enterCall = [&](const pta::CallGraphNodeTy *node, const CallIR *caller, const EventInfo *callerInfo) {
+    auto const func = node->getTargetFun()->getFunction();
+    if (callstack.contains(func)) {
+      return false;
+    }
+    callstack.push(func);
 
-  callstack.push(func);
+    if (DEBUG_PTA) {
+      llvm::outs() << "\nGenerating Func Sum: TID: " << thread.id << " Func: " << func->getName() << "\n";
+    }
 
-  if (DEBUG_PTA) {
-    llvm::outs() << "\nGenerating Func Sum: TID: " << thread.id << " Func: " << func->getName() << "\n";
-  }
+    auto summary = getFunctionSummary(func, state);
+    auto const einfo = storage.newEventInfo(thread, node->getContext());
+    std::optional<size_t> callInterval;
+    if (caller) {
+      callInterval = storage.calls.size();
+      storage.calls.push_back(CallInterval{caller, storage.nextID(), storage.nextID()});
+    }
+    frames.push_back(CallFrame{node, std::move(summary), einfo, 0, caller, callerInfo, callInterval, true, 1});
+    return true;
+  };
+
+  // Refer to the events of an earlier call of node instead of traversing it again. Returns false if the call must be
+  // traversed, because node was not traversed before, could not be shared, or is already being traversed (recursion)
+  auto const shareCall = [&](const pta::CallGraphNodeTy *node, const CallIR *caller, const EventInfo *callerInfo) {
+    if (!canShareCalls(thread, state)) return false;
+
+    auto const it = segments.find(node);
+    if (it == segments.end() || callstack.contains(node->getTargetFun()->getFunction())) return false;
+    auto const &segment = it->second;
+    if (budget.maxCallDepth > 0 && frames.size() + segment.height > budget.maxCallDepth) return false;
+
+    // the EnterCall event is kept even if call events are elided, as the shared events are placed at it
+    auto const at = storage.nextID();
+    storage.append<EnterCallEventImpl>(caller, callerInfo, at);
+    storage.segmentRefs.push_back(CallSegmentRef{caller, at, segment.begin, segment.end});
+    if (keepCallEvents) {
+      storage.append<LeaveCallEventImpl>(caller, callerInfo, storage.nextID());
+    }
+
+    auto &frame = frames.back();
+    frame.height = std::max(frame.height, segment.height + 1);
+    return true;
+  };
+
+  enterCall(entry, nullptr, nullptr);
+  bool outOfEvents = false;
+
+  while (!frames.empty()) {
+    auto &frame = frames.back();
+    if (outOfEvents || frame.next == frame.summary->size()) {
+      // return to the caller
+      if (frame.callInterval) {
+        auto &interval = storage.calls.at(frame.callInterval.value());
+        interval.end = storage.nextID();
+        if (frame.shareable && !outOfEvents && canShareCalls(thread, state)) {
+          segments.emplace(frame.node, CallSegment{interval.begin, interval.end, frame.height});
+        }
+        if (keepCallEvents) {
+          storage.append<LeaveCallEventImpl>(frame.caller, frame.callerInfo, storage.nextID());
+        }
+      }
+      auto const shareable = frame.shareable;
+      auto const height = frame.height;
+      callstack.pop();
+      frames.pop_back();
+      if (!frames.empty()) {
+        frames.back().shareable &= shareable;
+        frames.back().height = std::max(frames.back().height, height + 1);
+      }
+      continue;
+    }
+
+    auto const &ir = frame.summary->at(frame.next++);
+    auto const context = frame.node->getContext();
+    auto const einfo = frame.einfo;
 
-  auto const &summary = *state.builder.getFunctionSummary(func);
-  auto const context = node->getContext();
-  auto einfo = std::make_shared<EventInfo>(thread, context);
+    if (budget.maxThreadEvents > 0 && storage.nextID() >= budget.maxThreadEvents) {
+      storage.truncations.push_back(TraceTruncation{TraceTruncation::Reason::ThreadEvents, ir->getInst()});
+      outOfEvents = true;
+      continue;
+    }
 
-  for (auto const &ir : summary) {
     if (shouldSkipIR(ir, state)) {
+      frame.shareable = false;
       continue;
     }
     // Skip OpenMP synchronizations that have no affect across teams
     // TODO: How should single/master be modeled?
     if (state.openmp.inTeamsRegion() && isOpenMPTeamSpecific(ir.get())) {
+      frame.shareable = false;
       continue;
     }
 
+    // Calls that make sync events or OpenMP calls cannot be shared, see CallSegmentRef
+    if (!llvm::isa<MemAccessIR>(ir.get()) && !(llvm::isa<CallIR>(ir.get()) && ir->type == IR::Type::Call)) {
+      frame.shareable = false;
+    }
+
     if (auto readIR = llvm::dyn_cast<ReadIR>(ir.get())) {
-      std::shared_ptr<const ReadIR> read(ir, readIR);
-      events.push_back(std::make_unique<const ReadEventImpl>(read, einfo, events.size()));
+      auto accessedMemory = getAccessedMemory(context, readIR->getAccessedValue(), pta, state);
+      storage.append<ReadEventImpl>(readIR, einfo, accessedMemory, storage.nextID());
     } else if (auto writeIR = llvm::dyn_cast<WriteIR>(ir.get())) {
-      std::shared_ptr<const WriteIR> write(ir, writeIR);
-      events.push_back(std::make_unique<const WriteEventImpl>(write, einfo, events.size()));
+      auto accessedMemory = getAccessedMemory(context, writeIR->getAccessedValue(), pta, state);
+      storage.append<WriteEventImpl>(writeIR, einfo, accessedMemory, storage.nextID());
     } else if (auto forkIR = llvm::dyn_cast<ForkIR>(ir.get())) {
       // if spawned in single region, put omp task forks on master thread only
       if (forkIR->type == IR::Type::OpenMPTaskFork && state.openmp.inSingle && !isOpenMPMasterThread(thread)) {
         continue;
       }
 
-      std::shared_ptr<const ForkIR> fork(ir, forkIR);
-      events.push_back(std::make_unique<const ForkEventImpl>(fork, einfo, events.size()));
+      auto const forkEvent = storage.append<ForkEventImpl>(forkIR, einfo, storage.nextID());
 
       if (forkIR->type == IR::Type::OpenMPForkTeams) {
         state.openmp.teamsDepth++;
       }
 
-      // traverse this fork
-      auto event = events.back().get();
-      auto forkEvent = llvm::cast<ForkEvent>(event);
-
       // maintain the current traversed tasks in state.openmp.unjoinedTasks
       if (forkIR->type == IR::Type::OpenMPTaskFork) {
-        std::shared_ptr<const OpenMPTaskFork> task(fork, llvm::cast<OpenMPTaskFork>(fork.get()));
+        std::shared_ptr<const OpenMPTaskFork> task(ir, llvm::cast<OpenMPTaskFork>(forkIR));
         state.openmp.unjoinedTasks.emplace_back(forkEvent, task);
       }
 
-      auto entries = forkEvent->getThreadEntry();
+      auto entries = getThreadEntry(forkEvent, state);
       assert(!entries.empty());
 
       // Heuristic: just choose first entry if there are more than one
@@ -194,36 +383,30 @@ void traverseCallNode(const pta::CallGraphNodeTy *node, ThreadTrace &thread, Cal
     } else if (auto joinIR = llvm::dyn_cast<JoinIR>(ir.get())) {
       // insert task joins for state.unjoinedTasks before the end of this omp parallel region
       if (joinIR->type == IR::Type::OpenMPJoin) {
-        insertTaskJoins(events, state, einfo);
+        insertTaskJoins(storage, state, einfo);
       }
 
-      std::shared_ptr<const JoinIR> join(ir, joinIR);
-      events.push_back(std::make_unique<const JoinEventImpl>(join, einfo, events.size()));
+      storage.append<JoinEventImpl>(joinIR, einfo, storage.nextID());
     } else if (auto lockIR = llvm::dyn_cast<LockIR>(ir.get())) {
-      std::shared_ptr<const LockIR> lock(ir, lockIR);
-      events.push_back(std::make_unique<const LockEventImpl>(lock, einfo, events.size()));
+      storage.append<LockEventImpl>(lockIR, einfo, storage.nextID());
     } else if (auto unlockIR = llvm::dyn_cast<UnlockIR>(ir.get())) {
-      std::shared_ptr<const UnlockIR> lock(ir, unlockIR);
-      events.push_back(std::make_unique<const UnlockEventImpl>(lock, einfo, events.size()));
+      storage.append<UnlockEventImpl>(unlockIR, einfo, storage.nextID());
     } else if (auto barrierIR = llvm::dyn_cast<BarrierIR>(ir.get())) {
       // handle task joins at barriers
       if (barrierIR->type == IR::Type::OpenMPBarrier) {
-        insertTaskJoins(events, state, einfo);
+        insertTaskJoins(storage, state, einfo);
       }
 
-      std::shared_ptr<const BarrierIR> barrier(ir, barrierIR);
-      events.push_back(std::make_unique<const BarrierEventImpl>(barrier, einfo, events.size()));
+      storage.append<BarrierEventImpl>(barrierIR, einfo, storage.nextID());
     } else if (auto callIR = llvm::dyn_cast<CallIR>(ir.get())) {
-      std::shared_ptr<const CallIR> call(ir, callIR);
-
-      if (call->isIndirect()) {
+      if (callIR->isIndirect()) {
         // TODO: handle indirect
-        llvm::errs() << "Skipping indirect call: " << *call << "\n";
+        llvm::errs() << "Skipping indirect call: " << *callIR << "\n";
         continue;
       }
 
-      auto directContext = pta::CT::contextEvolve(context, ir->getInst());
-      auto callee = CallIR::resolveTargetFunction(call->getInst());
+      auto directContext = evolveContext(context, ir->getInst(), state);
+      auto callee = CallIR::resolveTargetFunction(callIR->getInst());
       if (callee == nullptr || callee->isIntrinsic() || callee->isDebugInfoForProfiling()) {
         continue;
       }
@@ -231,7 +414,7 @@ void traverseCallNode(const pta::CallGraphNodeTy *node, ThreadTrace &thread, Cal
       auto const directNode = pta.getDirectNodeOrNull(directContext, callee);
       if (directNode == nullptr) {
         // TODO: LOG unable to get child node
-        llvm::errs() << "Unable to get child node: " << call->getCalledFunction()->getName() << "from "
+        llvm::errs() << "Unable to get child node: " << callIR->getCalledFunction()->getName() << "from "
                      << *ir->getInst() << "\n";
         continue;
       }
@@ -243,56 +426,94 @@ void traverseCallNode(const pta::CallGraphNodeTy *node, ThreadTrace &thread, Cal
         }
         // insert task joins for state.unjoinedTasks when taskwait is encountered
         if (callIR->type == IR::Type::OpenMPTaskWait) {
-          insertTaskJoins(events, state, einfo);
+          insertTaskJoins(storage, state, einfo);
         }
       }
 
       if (directNode->getTargetFun()->isExtFunction()) {
-        events.push_back(std::make_unique<ExternCallEventImpl>(call, einfo, events.size()));
+        storage.append<ExternCallEventImpl>(callIR, einfo, storage.nextID());
         continue;
       }
 
-      events.push_back(std::make_unique<const EnterCallEventImpl>(call, einfo, events.size()));
-      traverseCallNode(directNode, thread, callstack, pta, events, threads, state);
-      events.push_back(std::make_unique<const LeaveCallEventImpl>(call, einfo, events.size()));
+      if (budget.maxCallDepth > 0 && frames.size() >= budget.maxCallDepth) {
+        storage.truncations.push_back(TraceTruncation{TraceTruncation::Reason::CallDepth, callIR->getInst()});
+        frame.shareable = false;
+        continue;
+      }
+
+      if (shareCall(directNode, callIR, einfo)) {
+        continue;
+      }
+      if (keepCallEvents) {
+        storage.append<EnterCallEventImpl>(callIR, einfo, storage.nextID());
+      }
+      if (!enterCall(directNode, callIR, einfo)) {
+        // the events of this call depend on the functions being traversed
+        frame.shareable = false;
+        // recursive calls are not traversed
+        storage.calls.push_back(CallInterval{callIR, storage.nextID(), storage.nextID()});
+        if (keepCallEvents) {
+          storage.append<LeaveCallEventImpl>(callIR, einfo, storage.nextID());
+        }
+      }
     } else {
       llvm_unreachable("Should cover all IR types");
     }
   }
-
-  callstack.pop();
 }
 
 }  // namespace
 
 void ThreadTrace::buildEventTrace(const pta::CallGraphNodeTy *entry, const pta::PTA &pta, TraceBuildState &state) {
-  CallStack callstack;
-  traverseCallNode(entry, *this, callstack, pta, events, childThreads, state);
+  TraceStorage storage{arena, events, syntheticIR, truncations, calls, segmentRefs};
+  traverseThread(entry, *this, pta, storage, childThreads, state);
+
+  for (auto const &event : events) {
+    if (auto fork = llvm::dyn_cast<ForkEvent>(event.get())) {
+      forkEvents.push_back(fork);
+    }
+  }
 }
 
 ThreadTrace::ThreadTrace(ProgramTrace &program, const pta::CallGraphNodeTy *entry, TraceBuildState &state)
-    : id(0), program(program), spawnSite(std::nullopt) {
+    : program(program), spawnSite(std::nullopt) {
   buildEventTrace(entry, program.pta, state);
 }
 
 ThreadTrace::ThreadTrace(const ForkEvent *spawningEvent, const pta::CallGraphNodeTy *entry, TraceBuildState &state)
-    : id(++state.currentTID), program(spawningEvent->getThread().program), spawnSite(spawningEvent) {
-  buildEventTrace(entry, program.pta, state);
-
-  auto const entries = spawningEvent->getThreadEntry();
+    : program(spawningEvent->getThread().program), spawnSite(spawningEvent) {
+#ifndef NDEBUG
+  auto const entries = getThreadEntry(spawningEvent, state);
   auto it = std::find(entries.begin(), entries.end(), entry);
   // entry mut be one of the entries from the spawning event
   assert(it != entries.end());
+#endif
+
+  if (canBuildLater(spawningEvent, state)) {
+    state.deferredThreads.push_back(DeferredThread{this, entry});
+    return;
+  }
+
+  buildEventTrace(entry, program.pta, state);
 }
 
-std::vector<const ForkEvent *> ThreadTrace::getForkEvents() const {
-  std::vector<const ForkEvent *> forks;
-  for (auto const &event : events) {
-    if (auto fork = llvm::dyn_cast<ForkEvent>(event.get())) {
-      forks.push_back(fork);
+std::vector<const CallIR *> ThreadTrace::getCallStack(EventID eid) const {
+  std::vector<const CallIR *> stack;
+  for (auto const &call : calls) {
+    if (call.begin > eid) break;
+    if (call.contains(eid)) {
+      stack.push_back(call.call);
     }
   }
-  return forks;
+  return stack;
+}
+
+llvm::ArrayRef<CallSegmentRef> ThreadTrace::getSegmentRefs(EventID begin, EventID end) const {
+  auto const first = std::lower_bound(segmentRefs.begin(), segmentRefs.end(), begin,
+                                      [](const CallSegmentRef &ref, EventID eid) { return ref.at < eid; });
+  auto const last = std::lower_bound(first, segmentRefs.end(), end,
+                                     [](const CallSegmentRef &ref, EventID eid) { return ref.at < eid; });
+  return llvm::ArrayRef<CallSegmentRef>(segmentRefs).slice(first - segmentRefs.begin(), last - first);
 }
 
 llvm::raw_ostream &race::operator<<(llvm::raw_ostream &os, const ThreadTrace &thread) {
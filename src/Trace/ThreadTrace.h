@@ -11,6 +11,9 @@ limitations under the License.
 
 #pragma once
 
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/Support/Allocator.h>
+
 #include <memory>
 #include <vector>
 
@@ -24,20 +27,82 @@ class ProgramTrace;
 
 using ThreadID = size_t;
 
+// Events are allocated in their thread's arena, so releasing an event only runs its destructor
+// The memory is freed all at once when the thread is destroyed
+struct ArenaEventDeleter {
+  void operator()(const Event *event) const { event->~Event(); }
+};
+using EventPtr = std::unique_ptr<const Event, ArenaEventDeleter>;
+
+// A point where building a thread trace stopped early because it ran out of TraceBudget
+struct TraceTruncation {
+  enum class Reason {
+    // a call was not traversed because the call stack was already TraceBudget::maxCallDepth deep
+    CallDepth,
+    // the rest of the thread was not traversed because it already had TraceBudget::maxThreadEvents events
+    ThreadEvents,
+  };
+
+  Reason reason;
+  // the call that was not traversed, or the first instruction that was not traversed
+  const llvm::Instruction *inst;
+};
+
+// A call traversed while building a thread trace
+// Events in [begin, end) were made by the called function or the functions it calls
+struct CallInterval {
+  const CallIR *call;
+  EventID begin;
+  EventID end;
+
+  [[nodiscard]] bool contains(EventID eid) const { return begin <= eid && eid < end; }
+};
+
+// A call to a function this thread already traversed in the same context, whose events were not made again.
+// The events in [begin, end) that the first call made stand in for the events of this call, as if they were made
+// right after the EnterCall event at, so the event at begin + i of the shared segment is the i-th event of this call.
+// Only calls that make no sync or OpenMP events, directly or in the functions they call, are shared
+struct CallSegmentRef {
+  const CallIR *call;
+  EventID at;
+  EventID begin;
+  EventID end;
+};
+
 class ThreadTrace {
  public:
-  const ThreadID id;
+  // Assigned by ProgramTrace in depth first order once every thread is built,
+  // so IDs do not depend on the order threads were built in
+  ThreadID id = 0;
   const ProgramTrace &program;
   // The fork event that created this thread
   // Optional because main thread does not have a spawn site
   const std::optional<const ForkEvent *> spawnSite;
 
-  [[nodiscard]] const std::vector<std::unique_ptr<const Event>> &getEvents() const { return events; }
-  [[nodiscard]] std::vector<const ForkEvent *> getForkEvents() const;
+  [[nodiscard]] const std::vector<EventPtr> &getEvents() const { return events; }
+  // Fork events in this thread, in event order
+  [[nodiscard]] const std::vector<const ForkEvent *> &getForkEvents() const { return forkEvents; }
 
   [[nodiscard]] const Event *getEvent(EventID id) const { return events.at(id).get(); }
 
-  [[nodiscard]] const std::vector<std::unique_ptr<const ThreadTrace>> &getChildThreads() const { return childThreads; }
+  [[nodiscard]] const std::vector<std::unique_ptr<ThreadTrace>> &getChildThreads() const { return childThreads; }
+
+  // Every call traversed by this thread, ordered by begin. Calls that were not traversed because of recursion have an
+  // empty interval. Recorded even if Call/CallEnd events are left out of the trace
+  [[nodiscard]] const std::vector<CallInterval> &getCalls() const { return calls; }
+
+  // The traversed calls that eid was made in, outermost first
+  [[nodiscard]] std::vector<const CallIR *> getCallStack(EventID eid) const;
+
+  // Calls that share the events of an earlier call instead of making their own, ordered by at. Always empty unless
+  // the trace was built with shared call segments, see ProgramTrace
+  [[nodiscard]] const std::vector<CallSegmentRef> &getSegmentRefs() const { return segmentRefs; }
+
+  // The shared calls whose EnterCall event is in [begin, end), ordered by at
+  [[nodiscard]] llvm::ArrayRef<CallSegmentRef> getSegmentRefs(EventID begin, EventID end) const;
+
+  // Places where this trace was cut short by the TraceBudget, in traversal order. Empty if the trace is complete
+  [[nodiscard]] const std::vector<TraceTruncation> &getTruncations() const { return truncations; }
 
   // Constructs the main thread.
   // All others should be built from forkEvent constructor
@@ -46,6 +111,8 @@ class ThreadTrace {
   // entry specifies the entry point of the spawned thread
   //  and should be one of the entries from the spawningEvent entry list
   // threads should be mutable reference to ProgramTrace's list of threads
+  // Threads that do not depend on the OpenMP state of their parent may be added to state.deferredThreads
+  // instead of being built immediately
   ThreadTrace(const ForkEvent *spawningEvent, const pta::CallGraphNodeTy *entry, TraceBuildState &state);
   ~ThreadTrace() = default;
   ThreadTrace(const ThreadTrace &) = delete;
@@ -54,8 +121,19 @@ class ThreadTrace {
   ThreadTrace &operator=(ThreadTrace &&other) = delete;
 
  private:
-  std::vector<std::unique_ptr<const Event>> events;
-  std::vector<std::unique_ptr<const ThreadTrace>> childThreads;
+  // Backing memory for events and their EventInfo. Declared before events so it outlives them
+  llvm::BumpPtrAllocator arena;
+  std::vector<EventPtr> events;
+  // IR created while building this trace that is not part of any function summary (e.g. OpenMP task joins)
+  std::vector<std::shared_ptr<const IR>> syntheticIR;
+  std::vector<std::unique_ptr<ThreadTrace>> childThreads;
+  // Cached once the event trace is built
+  std::vector<const ForkEvent *> forkEvents;
+  std::vector<TraceTruncation> truncations;
+  std::vector<CallInterval> calls;
+  std::vector<CallSegmentRef> segmentRefs;
+
+  friend class ProgramTrace;
 
   void buildEventTrace(const pta::CallGraphNodeTy *entry, const pta::PTA &pta, TraceBuildState &state);
 };
@@ -27,11 +27,67 @@ static llvm::cl::opt<std::string> DumpPreproccessedIR("dump-ir", cl::desc("Dump
 static llvm::cl::opt<std::string> DumpJSON("json", cl::desc("Dump JSON race report"),
                                            cl::value_desc("destination file"));
 
+static llvm::cl::opt<std::string> DumpFilterStats("filter-stats",
+                                                  cl::desc("Dump race filter and verdict cache statistics as JSON"),
+                                                  cl::value_desc("destination file"));
+
 static llvm::cl::opt<bool> PrintTrace("print-trace", cl::desc("print the program trace to stdout"), cl::init(true));
 
 static llvm::cl::opt<bool> DoCoverage(
     "do-cvg", cl::desc("Compute and print the coverage (= analyzed source code/all source code)"), cl::init(true));
 
+static llvm::cl::opt<unsigned> NumWorkers(
+    "workers",
+    cl::desc("Number of threads used for pointer analysis, to build traces and to check for races (0 uses all cores)"),
+    cl::init(1));
+
+static llvm::cl::opt<race::HappensBeforeGraph::Backend> HBBackend(
+    "hb", cl::desc("How happens-before reachability is computed"),
+    cl::values(clEnumValN(race::HappensBeforeGraph::Backend::Reachability, "reachability",
+                          "precompute the sync events reachable from every sync event"),
+               clEnumValN(race::HappensBeforeGraph::Backend::VectorClock, "vectorclock",
+                          "assign a vector clock to every sync event")),
+    cl::init(race::HappensBeforeGraph::Backend::Reachability));
+
+static llvm::cl::opt<unsigned> MaxRaces("max-races", cl::desc("Stop after finding this many races (0 finds all)"),
+                                        cl::init(0));
+
+static llvm::cl::opt<unsigned> TimeBudget(
+    "time-budget", cl::desc("Stop checking for races after this many seconds (0 means no limit)"), cl::init(0));
+
+static llvm::cl::opt<unsigned> MemoryBudget(
+    "memory-budget", cl::desc("Stop checking for races once memory use exceeds this many MB (0 means no limit)"),
+    cl::init(0));
+
+static llvm::cl::opt<unsigned> MaxCallDepth(
+    "max-call-depth", cl::desc("Do not traverse calls deeper than this in any thread (0 means no limit)"),
+    cl::init(0));
+
+static llvm::cl::opt<unsigned> MaxThreadEvents(
+    "max-thread-events", cl::desc("Stop building a thread once it has this many events (0 means no limit)"),
+    cl::init(0));
+
+static llvm::cl::opt<bool> SkipThreadPrivate(
+    "skip-thread-private", cl::desc("Leave accesses to objects that never escape their function out of the trace"),
+    cl::init(true));
+
+static llvm::cl::opt<bool> CoalesceAccesses(
+    "coalesce-accesses", cl::desc("Check repeated accesses to the same value in a basic block only once"),
+    cl::init(true));
+
+static llvm::cl::opt<bool> ElideCallEvents(
+    "elide-call-events", cl::desc("Leave call and return events out of thread traces to make them smaller"),
+    cl::init(false));
+
+static llvm::cl::opt<bool> ShareCallSegments(
+    "share-call-segments",
+    cl::desc("Traverse each function once per calling context, repeated calls share the events of the first one"),
+    cl::init(false));
+
+static llvm::cl::opt<std::string> CacheDir(
+    "cache-dir", cl::desc("Reuse race reports of unchanged modules analyzed with the same options from this directory"),
+    cl::value_desc("directory"));
+
 int main(int argc, char** argv) {
   llvm::InitLLVM X(argc, argv);
   llvm::cl::ParseCommandLineOptions(argc, argv);
@@ -58,8 +114,28 @@ int main(int argc, char** argv) {
   }
   config.printTrace = PrintTrace;
   config.doCoverage = DoCoverage;
+  config.numWorkers = NumWorkers;
+  config.hbBackend = HBBackend;
+  if (!DumpFilterStats.empty()) {
+    config.dumpFilterStats = DumpFilterStats;
+  }
+  config.maxRaces = MaxRaces;
+  config.timeBudget = std::chrono::seconds(TimeBudget);
+  config.memoryBudgetMB = MemoryBudget;
+  config.traceBudget.maxCallDepth = MaxCallDepth;
+  config.traceBudget.maxThreadEvents = MaxThreadEvents;
+  config.skipThreadPrivate = SkipThreadPrivate;
+  config.coalesceAccesses = CoalesceAccesses;
+  config.elideCallEvents = ElideCallEvents;
+  config.shareCallSegments = ShareCallSegments;
+  if (!CacheDir.empty()) {
+    config.cacheDir = CacheDir;
+  }
 
   auto report = race::detectRaces(module.get(), config);
+  if (!report.complete) {
+    llvm::outs() << "Race detection stopped early or skipped part of the program, the report may be incomplete.\n";
+  }
   if (report.empty()) {
     llvm::outs() << "No races detected.\n";
     return 0;
@@ -118,6 +118,23 @@ Oracle::Oracle(llvm::StringRef filename, std::vector<llvm::StringRef> races) : f
   expectedRaces = TestRace::fromStrings(std::move(races));
 }
 
+DetectedRaces detectRacesInFile(const std::string &file, const race::DetectRaceConfig &config) {
+  llvm::LLVMContext context;
+  llvm::SMDiagnostic err;
+  auto module = llvm::parseIRFile(file, err, context);
+  if (!module) {
+    err.print(file.c_str(), llvm::errs());
+  }
+  REQUIRE(module.get() != nullptr);
+
+  auto const report = race::detectRaces(module.get(), config);
+
+  // races hold instructions from this module, so convert them before it is destroyed
+  auto races = TestRace::fromRaces(report.races);
+  std::sort(races.begin(), races.end());
+  return DetectedRaces{races, report.complete, report.fromCache};
+}
+
 void checkTest(llvm::StringRef file, llvm::StringRef llPath, std::initializer_list<llvm::StringRef> expected) {
   llvm::LLVMContext context;
   llvm::SMDiagnostic err;
@@ -16,6 +16,7 @@ limitations under the License.
 #include <set>
 #include <vector>
 
+#include "RaceDetect.h"
 #include "Reporter/Reporter.h"
 
 // used for testing
@@ -67,6 +68,16 @@ void checkOracles(const std::vector<Oracle> &oracles, llvm::StringRef llPath);
 
 void checkTest(llvm::StringRef file, llvm::StringRef llPath, std::initializer_list<llvm::StringRef> expected);
 
+// The races found in a single run of detectRaces, sorted so that runs can be compared
+struct DetectedRaces {
+  std::vector<TestRace> races;
+  bool complete;
+  bool fromCache;
+};
+
+// Run detectRaces on a freshly parsed copy of file, since detectRaces modifies the module during preprocessing
+DetectedRaces detectRacesInFile(const std::string &file, const race::DetectRaceConfig &config);
+
 // Helpers for testing
 bool reportContains(const race::Report &report, TestRace race);
 bool reportContains(const race::Report &report, std::vector<TestRace> races);
@@ -0,0 +1,110 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+
+#include <catch2/catch.hpp>
+
+#include "helpers/ReportChecking.h"
+
+// see PointerAnalysis/CMDOptions.cpp
+extern llvm::cl::opt<unsigned> Max_Indirect_Target;
+
+namespace {
+
+DetectedRaces detectWithCache(const std::string &file, const std::string &cacheDir) {
+  race::DetectRaceConfig config;
+  config.cacheDir = cacheDir;
+  return detectRacesInFile(file, config);
+}
+
+size_t countEntries(const std::string &dir) {
+  size_t count = 0;
+  std::error_code err;
+  for (llvm::sys::fs::directory_iterator it(dir, err), end; it != end && !err; it.increment(err)) {
+    ++count;
+  }
+  return count;
+}
+
+}  // namespace
+
+TEST_CASE("Race checking with a report cache", "[integration][cache]") {
+  auto file = GENERATE(as<std::string>{}, "integration/dataracebench/DRB005-indirectaccess1-orig-yes.ll",
+                       "integration/openmp/reduction-nowait-yes.ll", "integration/pthreadrace/pthread-simple-yes.ll");
+
+  llvm::SmallString<128> cacheDir;
+  REQUIRE_FALSE(llvm::sys::fs::createUniqueDirectory("openrace-cache", cacheDir));
+
+  auto const stored = detectWithCache(file, cacheDir.str().str());
+  CHECK(stored.complete);
+  CHECK_FALSE(stored.fromCache);
+  REQUIRE_FALSE(stored.races.empty());
+  CHECK(countEntries(cacheDir.str().str()) == 1);
+
+  auto const loaded = detectWithCache(file, cacheDir.str().str());
+  CHECK(loaded.complete);
+  CHECK(loaded.fromCache);
+  CHECK(loaded.races == stored.races);
+  CHECK(countEntries(cacheDir.str().str()) == 1);
+
+  llvm::sys::fs::remove_directories(cacheDir);
+}
+
+TEST_CASE("Pointer analysis options are part of the report cache key", "[integration][cache]") {
+  auto const file = "integration/pthreadrace/pthread-simple-yes.ll";
+
+  llvm::SmallString<128> cacheDir;
+  REQUIRE_FALSE(llvm::sys::fs::createUniqueDirectory("openrace-cache", cacheDir));
+
+  auto const stored = detectWithCache(file, cacheDir.str().str());
+  CHECK_FALSE(stored.fromCache);
+  CHECK(countEntries(cacheDir.str().str()) == 1);
+
+  // the options are global, restore them for the other tests
+  auto const maxIndirectTarget = Max_Indirect_Target.getValue();
+  Max_Indirect_Target = maxIndirectTarget + 1;
+  auto const changed = detectWithCache(file, cacheDir.str().str());
+  Max_Indirect_Target = maxIndirectTarget;
+
+  CHECK_FALSE(changed.fromCache);
+  CHECK(countEntries(cacheDir.str().str()) == 2);
+
+  auto const loaded = detectWithCache(file, cacheDir.str().str());
+  CHECK(loaded.fromCache);
+  CHECK(loaded.races == stored.races);
+
+  llvm::sys::fs::remove_directories(cacheDir);
+}
+
+TEST_CASE("Do not read the report cache when filter statistics are requested", "[integration][cache]") {
+  auto const file = "integration/pthreadrace/pthread-simple-yes.ll";
+
+  llvm::SmallString<128> cacheDir;
+  REQUIRE_FALSE(llvm::sys::fs::createUniqueDirectory("openrace-cache", cacheDir));
+
+  auto const stored = detectWithCache(file, cacheDir.str().str());
+  CHECK_FALSE(stored.fromCache);
+
+  llvm::SmallString<128> statsFile(cacheDir);
+  llvm::sys::path::append(statsFile, "stats.json");
+  race::DetectRaceConfig config;
+  config.cacheDir = cacheDir.str().str();
+  config.dumpFilterStats = statsFile.str().str();
+  auto const checked = detectRacesInFile(file, config);
+  CHECK_FALSE(checked.fromCache);
+  CHECK(checked.races == stored.races);
+  CHECK(llvm::sys::fs::exists(statsFile));
+
+  llvm::sys::fs::remove_directories(cacheDir);
+}
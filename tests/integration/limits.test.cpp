@@ -0,0 +1,54 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <catch2/catch.hpp>
+
+#include "helpers/ReportChecking.h"
+
+TEST_CASE("Race checking with limits", "[integration][limits]") {
+  auto file = GENERATE(as<std::string>{}, "integration/dataracebench/DRB005-indirectaccess1-orig-yes.ll",
+                       "integration/dataracebench/DRB021-reductionmissing-orig-yes.ll",
+                       "integration/pthreadrace/pthread-simple-yes.ll");
+
+  auto const full = detectRacesInFile(file, race::DetectRaceConfig{});
+  CHECK(full.complete);
+  REQUIRE_FALSE(full.races.empty());
+
+  SECTION("Stop after first race") {
+    race::DetectRaceConfig config;
+    config.maxRaces = 1;
+    auto const partial = detectRacesInFile(file, config);
+
+    CHECK_FALSE(partial.complete);
+    CHECK_FALSE(partial.races.empty());
+    CHECK(std::includes(full.races.begin(), full.races.end(), partial.races.begin(), partial.races.end()));
+  }
+
+  SECTION("Exceeded memory budget stops checking") {
+    // The peak memory of the test process is always above 1MB, so checking stops before the first object
+    race::DetectRaceConfig config;
+    config.memoryBudgetMB = 1;
+    auto const partial = detectRacesInFile(file, config);
+
+    CHECK_FALSE(partial.complete);
+    CHECK(std::includes(full.races.begin(), full.races.end(), partial.races.begin(), partial.races.end()));
+  }
+
+  SECTION("Generous budget checks everything") {
+    race::DetectRaceConfig config;
+    config.timeBudget = std::chrono::hours(1);
+    config.memoryBudgetMB = 1024 * 1024;
+    auto const budgeted = detectRacesInFile(file, config);
+
+    CHECK(budgeted.complete);
+    CHECK(budgeted.races == full.races);
+  }
+}
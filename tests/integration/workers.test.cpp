@@ -0,0 +1,34 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <catch2/catch.hpp>
+
+#include "helpers/ReportChecking.h"
+
+namespace {
+
+std::vector<TestRace> detectWithWorkers(const std::string &file, unsigned int numWorkers) {
+  race::DetectRaceConfig config;
+  config.numWorkers = numWorkers;
+  return detectRacesInFile(file, config).races;
+}
+
+}  // namespace
+
+TEST_CASE("Race checking with multiple workers", "[integration][workers]") {
+  auto file = GENERATE(as<std::string>{}, "integration/dataracebench/DRB005-indirectaccess1-orig-yes.ll",
+                       "integration/dataracebench/DRB021-reductionmissing-orig-yes.ll",
+                       "integration/openmp/reduction-nowait-yes.ll", "integration/pthreadrace/pthread-simple-yes.ll");
+
+  auto const serial = detectWithWorkers(file, 1);
+  CHECK(detectWithWorkers(file, 2) == serial);
+  CHECK(detectWithWorkers(file, 8) == serial);
+}
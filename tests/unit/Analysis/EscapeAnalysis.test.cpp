@@ -0,0 +1,121 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <llvm/AsmParser/Parser.h>
+#include <llvm/IR/InstIterator.h>
+
+#include <catch2/catch.hpp>
+
+#include "Analysis/EscapeAnalysis.h"
+#include "Trace/ProgramTrace.h"
+
+namespace {
+
+const llvm::Instruction *findInst(const llvm::Function *func, llvm::StringRef name) {
+  for (auto const &inst : llvm::instructions(func)) {
+    if (inst.getName() == name) return &inst;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+TEST_CASE("Escape analysis", "[unit][escape]") {
+  const char *ModuleString = R"(
+%union.pthread_attr_t = type { i64, [48 x i8] }
+
+@global = global i64* null
+
+define void @readOnly(i64* %p) {
+  %val = load i64, i64* %p
+  ret void
+}
+
+define void @leak(i64* %p) {
+  store i64* %p, i64** @global
+  ret void
+}
+
+define i8* @worker(i8* %arg) {
+  ret i8* null
+}
+
+define void @foo() {
+  %local = alloca i64
+  %passed = alloca i64
+  %leaked = alloca i64
+  %global = alloca i64
+  %spawned = alloca i64
+  %handle = alloca i64
+  %heap = call i8* @malloc(i64 8)
+  %heapLeaked = call i8* @malloc(i64 8)
+  store i64 1, i64* %local
+  %1 = load i64, i64* %local
+  store i64 1, i64* %passed
+  call void @readOnly(i64* %passed)
+  call void @leak(i64* %leaked)
+  store i64* %global, i64** @global
+  %arg = bitcast i64* %spawned to i8*
+  %2 = call i32 @pthread_create(i64* %handle, %union.pthread_attr_t* null, i8* (i8*)* @worker, i8* %arg)
+  %heapInt = bitcast i8* %heap to i64*
+  store i64 1, i64* %heapInt
+  %heapLeakedInt = bitcast i8* %heapLeaked to i64*
+  store i64* %heapLeakedInt, i64** @global
+  ret void
+}
+
+declare i8* @malloc(i64)
+declare i32 @pthread_create(i64*, %union.pthread_attr_t*, i8* (i8*)*, i8*)
+)";
+
+  llvm::LLVMContext Ctx;
+  llvm::SMDiagnostic Err;
+  auto module = llvm::parseAssemblyString(ModuleString, Err, Ctx);
+
+  SECTION("Thread private objects") {
+    race::EscapeAnalysis escape(*module);
+    auto const foo = module->getFunction("foo");
+
+    CHECK(escape.isThreadPrivate(findInst(foo, "local")));
+    CHECK(escape.isThreadPrivate(findInst(foo, "passed")));
+    CHECK(escape.isThreadPrivate(findInst(foo, "heap")));
+    CHECK_FALSE(escape.isThreadPrivate(findInst(foo, "leaked")));
+    CHECK_FALSE(escape.isThreadPrivate(findInst(foo, "global")));
+    CHECK_FALSE(escape.isThreadPrivate(findInst(foo, "spawned")));
+    CHECK_FALSE(escape.isThreadPrivate(findInst(foo, "handle")));
+    CHECK_FALSE(escape.isThreadPrivate(findInst(foo, "heapLeaked")));
+    CHECK(escape.numThreadPrivate() == 3);
+
+    // accesses through casts of a private object are private
+    CHECK(escape.isThreadPrivateAccess(findInst(foo, "heapInt")));
+    CHECK_FALSE(escape.isThreadPrivateAccess(findInst(foo, "heapLeakedInt")));
+  }
+
+  SECTION("Thread private accesses are left out of the trace") {
+    race::ProgramTrace program(module.get(), "foo", 1, race::TraceBudget(), true);
+    auto const escape = program.getEscapeAnalysis();
+    REQUIRE(escape != nullptr);
+    REQUIRE(program.getThreads().size() == 2);
+
+    bool foundReadOnlyLoad = false;
+    for (auto const &event : program.getThreads().at(0)->getEvents()) {
+      auto const access = llvm::dyn_cast<race::MemAccessEvent>(event.get());
+      if (!access) continue;
+
+      auto const accessed = access->getIRInst()->getAccessedValue();
+      CHECK_FALSE(escape->isThreadPrivateAccess(accessed));
+      CHECK(accessed->getName() != "passed");
+      if (access->getFunction()->getName() == "readOnly") foundReadOnlyLoad = true;
+    }
+    // accesses through an argument are kept, only the object itself is private
+    CHECK(foundReadOnlyLoad);
+  }
+}
@@ -48,7 +48,10 @@ declare i32 @pthread_join(i64, i8**)
 
   race::ProgramTrace program(module.get(), "foo");
 
-  race::HappensBeforeGraph happensbefore(program);
+  // both backends must produce the same results
+  auto const backend = GENERATE(race::HappensBeforeGraph::Backend::Reachability,
+                                race::HappensBeforeGraph::Backend::VectorClock);
+  race::HappensBeforeGraph happensbefore(program, backend);
 
   auto const &threads = program.getThreads();
   REQUIRE(threads.size() == 2);
@@ -107,7 +110,10 @@ declare void @__kmpc_fork_call(%struct.ident_t*, i32, void (i32*, i32*, ...)*, .
   }
 
   race::ProgramTrace program(module.get());
-  race::HappensBeforeGraph happensbefore(program);
+  // both backends must produce the same results
+  auto const backend = GENERATE(race::HappensBeforeGraph::Backend::Reachability,
+                                race::HappensBeforeGraph::Backend::VectorClock);
+  race::HappensBeforeGraph happensbefore(program, backend);
 
   REQUIRE(program.getThreads().size() == 3);
 
@@ -95,4 +95,13 @@ declare i32 @pthread_mutex_unlock(%union.pthread_mutex_t*) #1
       CHECK(!lockset.sharesLock(holdsLock, noLock));
     }
   }
+
+  // Events holding the same locks share one interned lock set
+  for (auto idx : sharedIdxs) {
+    CHECK(lockset.getLockSetID(events.at(idx).get()) == lockset.getLockSetID(events.at(sharedIdxs.front()).get()));
+    CHECK(lockset.getLocks(lockset.getLockSetID(events.at(idx).get())).size() == 1);
+  }
+  for (auto idx : emptyIdxs) {
+    CHECK(lockset.getLocks(lockset.getLockSetID(events.at(idx).get())).empty());
+  }
 }
\ No newline at end of file
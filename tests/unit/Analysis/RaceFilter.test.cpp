@@ -0,0 +1,79 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <catch2/catch.hpp>
+
+#include "Analysis/RaceFilter.h"
+
+namespace {
+
+// Either rejects every pair or never rejects, counting how often it is called
+class StubFilter : public race::RaceFilter {
+  std::string name;
+  bool reject;
+  size_t &calls;
+
+ public:
+  StubFilter(std::string name, bool reject, size_t &calls) : name(std::move(name)), reject(reject), calls(calls) {}
+
+  [[nodiscard]] llvm::StringRef getName() const override { return name; }
+  [[nodiscard]] bool rejects(const race::WriteEvent *, const race::MemAccessEvent *) override {
+    ++calls;
+    return reject;
+  }
+};
+
+}  // namespace
+
+TEST_CASE("Race filter pipeline", "[unit][filter]") {
+  size_t neverCalls = 0;
+  size_t alwaysCalls = 0;
+
+  SECTION("Stops at first rejecting filter") {
+    race::RaceFilterPipeline pipeline(0);
+    pipeline.add(std::make_unique<StubFilter>("never", false, neverCalls));
+    pipeline.add(std::make_unique<StubFilter>("always", true, alwaysCalls));
+
+    for (int i = 0; i < 10; ++i) {
+      CHECK(pipeline.rejects(nullptr, nullptr));
+    }
+    CHECK(neverCalls == 10);
+    CHECK(alwaysCalls == 10);
+
+    auto const stats = pipeline.getStatsJSON();
+    REQUIRE(stats.size() == 2);
+    CHECK(stats.at(0).at("name") == "never");
+    CHECK(stats.at(0).at("invocations") == 10);
+    CHECK(stats.at(0).at("rejections") == 0);
+    CHECK(stats.at(1).at("name") == "always");
+    CHECK(stats.at(1).at("rejections") == 10);
+    CHECK(stats.at(1).at("rejectionRate") == 1.0);
+  }
+
+  SECTION("Reordering moves rejecting filters first") {
+    race::RaceFilterPipeline pipeline(4);
+    pipeline.add(std::make_unique<StubFilter>("never", false, neverCalls));
+    pipeline.add(std::make_unique<StubFilter>("always", true, alwaysCalls));
+
+    for (int i = 0; i < 10; ++i) {
+      CHECK(pipeline.rejects(nullptr, nullptr));
+    }
+    // reordered before the 4th check, after which "never" is no longer reached
+    CHECK(neverCalls == 3);
+    CHECK(alwaysCalls == 10);
+    CHECK(pipeline.getStatsJSON().at(0).at("name") == "always");
+  }
+
+  SECTION("No filters never rejects") {
+    race::RaceFilterPipeline pipeline;
+    CHECK_FALSE(pipeline.rejects(nullptr, nullptr));
+  }
+}
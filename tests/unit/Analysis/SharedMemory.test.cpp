@@ -49,4 +49,221 @@ declare i32 @pthread_join(i64, i8**)
 
   race::ProgramTrace program(module.get(), "foo");
   race::SharedMemory sharedmem(program);
+
+  // %c is only accessed by the spawned thread
+  CHECK(sharedmem.getSharedObjects().empty());
+
+  auto const &threads = program.getThreads();
+  REQUIRE(threads.size() == 2);
+  auto const &events = threads.at(1)->getEvents();
+  auto const write = std::find_if(events.begin(), events.end(),
+                                  [](auto const &e) { return llvm::isa<race::WriteEvent>(e.get()); });
+  REQUIRE(write != events.end());
+  auto const &pts = llvm::cast<race::WriteEvent>(write->get())->getAccessedMemory();
+  REQUIRE(!pts.empty());
+
+  auto const threadedWrites = sharedmem.getThreadedWrites(*pts.begin());
+  REQUIRE(threadedWrites.size() == 1);
+  CHECK(threadedWrites.front().tid == threads.at(1)->id);
+  REQUIRE(threadedWrites.front().intervals.size() == 1);
+  CHECK(threadedWrites.front().intervals.front().events.front() == write->get());
+
+  auto const threadedReads = sharedmem.getThreadedReads(*pts.begin());
+  REQUIRE(threadedReads.size() == 1);
+  CHECK(threadedReads.front().intervals.size() == 1);
+}
+
+TEST_CASE("Coalesce repeated accesses in SharedMemory", "[unit][sharedmemory]") {
+  const char *ModuleString = R"(
+%union.pthread_attr_t = type { i64, [48 x i8] }
+
+@x = global i64 0
+
+define i8* @entry(i8* %arg) {
+  %p = bitcast i8* %arg to i64*
+  %a = load i64, i64* @x
+  store i64 %a, i64* %p
+  %b = load i64, i64* @x
+  store i64 %b, i64* %p
+  ret i8* null
+}
+
+define void @foo() {
+  %p_thread = alloca i64
+  %1 = call i32 @pthread_create(i64* %p_thread, %union.pthread_attr_t* null, i8* (i8*)* @entry, i8* null)
+  %thread = load i64, i64* %p_thread
+  %2 = call i32 @pthread_join(i64 %thread, i8** null)
+  ret void
+}
+
+declare i32 @pthread_create(i64*, %union.pthread_attr_t*, i8* (i8*)*, i8*)
+declare i32 @pthread_join(i64, i8**)
+)";
+
+  llvm::LLVMContext Ctx;
+  llvm::SMDiagnostic Err;
+  auto module = llvm::parseAssemblyString(ModuleString, Err, Ctx);
+
+  race::ProgramTrace program(module.get(), "foo");
+  auto const &threads = program.getThreads();
+  REQUIRE(threads.size() == 2);
+
+  std::vector<const race::ReadEvent *> reads;
+  for (auto const &event : threads.at(1)->getEvents()) {
+    if (auto read = llvm::dyn_cast<race::ReadEvent>(event.get())) {
+      reads.push_back(read);
+    }
+  }
+  REQUIRE(reads.size() == 2);
+  REQUIRE(reads.front()->getAccessedMemory().size() == 1);
+  auto const x = reads.front()->getAccessedMemory().front();
+
+  SECTION("Coalesced") {
+    race::SharedMemory sharedmem(program);
+
+    auto const threadedReads = sharedmem.getThreadedReads(x);
+    REQUIRE(threadedReads.size() == 1);
+    REQUIRE(threadedReads.front().intervals.size() == 1);
+    auto const &events = threadedReads.front().intervals.front().events;
+    REQUIRE(events.size() == 1);
+    CHECK(events.front() == reads.front());
+
+    auto const coalesced = sharedmem.getCoalesced(reads.front());
+    REQUIRE(coalesced.size() == 1);
+    CHECK(coalesced.front() == reads.back());
+    CHECK(sharedmem.getCoalesced(reads.back()).empty());
+    // the second store to %p is coalesced as well
+    CHECK(sharedmem.numCoalesced() == 2);
+  }
+
+  SECTION("Not coalesced") {
+    race::SharedMemory sharedmem(program, false);
+
+    auto const threadedReads = sharedmem.getThreadedReads(x);
+    REQUIRE(threadedReads.size() == 1);
+    CHECK(threadedReads.front().intervals.front().events.size() == 2);
+    CHECK(sharedmem.getCoalesced(reads.front()).empty());
+    CHECK(sharedmem.numCoalesced() == 0);
+  }
+}
+
+TEST_CASE("Only coalesce accesses with the same alias scope metadata", "[unit][sharedmemory]") {
+  const char *ModuleString = R"(
+%union.pthread_attr_t = type { i64, [48 x i8] }
+
+@x = global i64 0
+
+define i8* @entry(i8* %arg) {
+  %a = load i64, i64* @x, !alias.scope !0
+  %b = load i64, i64* @x
+  %c = load i64, i64* @x, !noalias !0
+  ret i8* null
+}
+
+define void @foo() {
+  %p_thread = alloca i64
+  %1 = call i32 @pthread_create(i64* %p_thread, %union.pthread_attr_t* null, i8* (i8*)* @entry, i8* null)
+  %thread = load i64, i64* %p_thread
+  %2 = call i32 @pthread_join(i64 %thread, i8** null)
+  ret void
+}
+
+declare i32 @pthread_create(i64*, %union.pthread_attr_t*, i8* (i8*)*, i8*)
+declare i32 @pthread_join(i64, i8**)
+
+!0 = !{!1}
+!1 = distinct !{!1, !2, !"scope"}
+!2 = distinct !{!2, !"domain"}
+)";
+
+  llvm::LLVMContext Ctx;
+  llvm::SMDiagnostic Err;
+  auto module = llvm::parseAssemblyString(ModuleString, Err, Ctx);
+
+  race::ProgramTrace program(module.get(), "foo");
+  auto const &threads = program.getThreads();
+  REQUIRE(threads.size() == 2);
+
+  std::vector<const race::ReadEvent *> reads;
+  for (auto const &event : threads.at(1)->getEvents()) {
+    if (auto read = llvm::dyn_cast<race::ReadEvent>(event.get())) {
+      reads.push_back(read);
+    }
+  }
+  REQUIRE(reads.size() == 3);
+  auto const x = reads.front()->getAccessedMemory().front();
+
+  race::SharedMemory sharedmem(program);
+  auto const threadedReads = sharedmem.getThreadedReads(x);
+  REQUIRE(threadedReads.size() == 1);
+  CHECK(threadedReads.front().intervals.front().events.size() == 3);
+  CHECK(sharedmem.numCoalesced() == 0);
+}
+
+TEST_CASE("Add accesses of shared calls to the interval of each call", "[unit][sharedmemory]") {
+  const char *ModuleString = R"(
+%union.pthread_attr_t = type { i64, [48 x i8] }
+
+@x = global i64 0
+
+define void @adder() {
+    %val = load i64, i64* @x
+    %add = add nsw i64 %val, 42
+    store i64 %add, i64* @x
+    ret void
+}
+
+define void @mid() {
+    call void @adder()
+    ret void
+}
+
+define i8* @entry(i8*) {
+    ret i8* null
+}
+
+define void @foo() {
+  %p_thread = alloca i64
+  call void @mid()
+  %1 = call i32 @pthread_create(i64* %p_thread, %union.pthread_attr_t* null, i8* (i8*)* @entry, i8* null)
+  call void @mid()
+  call void @mid()
+  ret void
+}
+
+declare i32 @pthread_create(i64*, %union.pthread_attr_t*, i8* (i8*)*, i8*)
+)";
+
+  llvm::LLVMContext Ctx;
+  llvm::SMDiagnostic Err;
+  auto module = llvm::parseAssemblyString(ModuleString, Err, Ctx);
+  if (!module) {
+    Err.print("error", llvm::errs());
+  }
+
+  race::ProgramTrace program(module.get(), "foo", 1, race::TraceBudget(), false, false, true);
+  race::SharedMemory sharedmem(program);
+
+  auto const &thread = program.getThreads().at(0);
+  auto const &events = thread->getEvents();
+  auto const write = std::find_if(events.begin(), events.end(),
+                                  [](auto const &e) { return llvm::isa<race::WriteEvent>(e.get()); });
+  REQUIRE(write != events.end());
+  auto const &pts = llvm::cast<race::WriteEvent>(write->get())->getAccessedMemory();
+  REQUIRE(pts.size() == 1);
+
+  // adder is only traversed before the fork, the two calls after it share its events
+  auto const &refs = thread->getSegmentRefs();
+  REQUIRE(refs.size() == 2);
+
+  // the write is in the interval before the fork, and once in the interval after it on behalf of the first shared call
+  auto const threadedWrites = sharedmem.getThreadedWrites(*pts.begin());
+  REQUIRE(threadedWrites.size() == 1);
+  auto const &intervals = threadedWrites.front().intervals;
+  REQUIRE(intervals.size() == 2);
+  CHECK(intervals[0].events.size() == 1);
+  CHECK(intervals[0].anchor == write->get());
+  CHECK(intervals[1].events.size() == 1);
+  CHECK(intervals[1].events.front() == write->get());
+  CHECK(intervals[1].anchor == thread->getEvent(refs.front().at));
 }
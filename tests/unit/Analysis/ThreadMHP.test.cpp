@@ -0,0 +1,94 @@
+/* Copyright 2021 Coderrect Inc. All Rights Reserved.
+Licensed under the GNU Affero General Public License, version 3 or later (“AGPL”), as published by the Free Software
+Foundation. You may not use this file except in compliance with the License. You may obtain a copy of the License at
+https://www.gnu.org/licenses/agpl-3.0.en.html
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an “AS IS” BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <llvm/AsmParser/Parser.h>
+
+#include <catch2/catch.hpp>
+
+#include "Analysis/ThreadMHP.h"
+
+TEST_CASE("Thread level MHP", "[unit][mhp]") {
+  const char *ModuleString = R"(
+%union.pthread_attr_t = type { i64, [48 x i8] }
+
+@x = global i32 0
+@y = global i32 0
+
+define i8* @writeBoth(i8* %arg) {
+  store i32 1, i32* @x
+  store i32 1, i32* @y
+  ret i8* null
+}
+
+define i8* @writeX(i8* %arg) {
+  store i32 2, i32* @x
+  ret i8* null
+}
+
+define i8* @writeY(i8* %arg) {
+  store i32 2, i32* @y
+  ret i8* null
+}
+
+define void @foo() {
+  %p_t1 = alloca i64
+  %p_t2 = alloca i64
+  %p_t3 = alloca i64
+  %1 = call i32 @pthread_create(i64* %p_t1, %union.pthread_attr_t* null, i8* (i8*)* @writeBoth, i8* null)
+  %t1 = load i64, i64* %p_t1
+  %2 = call i32 @pthread_join(i64 %t1, i8** null)
+  %3 = call i32 @pthread_create(i64* %p_t2, %union.pthread_attr_t* null, i8* (i8*)* @writeX, i8* null)
+  %4 = call i32 @pthread_create(i64* %p_t3, %union.pthread_attr_t* null, i8* (i8*)* @writeY, i8* null)
+  %t2 = load i64, i64* %p_t2
+  %5 = call i32 @pthread_join(i64 %t2, i8** null)
+  %t3 = load i64, i64* %p_t3
+  %6 = call i32 @pthread_join(i64 %t3, i8** null)
+  ret void
+}
+
+declare i32 @pthread_create(i64*, %union.pthread_attr_t*, i8* (i8*)*, i8*)
+declare i32 @pthread_join(i64, i8**)
+)";
+
+  llvm::LLVMContext Ctx;
+  llvm::SMDiagnostic Err;
+  auto module = llvm::parseAssemblyString(ModuleString, Err, Ctx);
+  if (!module) {
+    Err.print("error", llvm::errs());
+  }
+
+  race::ProgramTrace program(module.get(), "foo");
+  race::HappensBeforeGraph happensbefore(program);
+  race::SharedMemory sharedmem(program);
+  race::ThreadMHP mhp(program, happensbefore);
+
+  auto const &threads = program.getThreads();
+  REQUIRE(threads.size() == 4);
+  auto const main = threads.at(0)->id;
+  auto const t1 = threads.at(1)->id;
+  auto const t2 = threads.at(2)->id;
+  auto const t3 = threads.at(3)->id;
+
+  // t1 is joined before t2 and t3 are forked
+  CHECK_FALSE(mhp.mayOverlap(t1, t2));
+  CHECK_FALSE(mhp.mayOverlap(t3, t1));
+  CHECK(mhp.mayOverlap(t2, t3));
+  CHECK(mhp.mayOverlap(t3, t2));
+  CHECK(mhp.mayOverlap(main, t1));
+  CHECK_FALSE(mhp.mayOverlap(t1, t1));
+
+  // x is written by t1 and t2, y by t1 and t3, so neither can race
+  REQUIRE(sharedmem.getSharedObjects().size() == 2);
+  auto const kept = mhp.pruneSharedObjects(sharedmem);
+  CHECK(kept.empty());
+  CHECK(mhp.getNumPrunedObjects() == 2);
+  CHECK(mhp.getNumPrunedPairs() == 2);
+}
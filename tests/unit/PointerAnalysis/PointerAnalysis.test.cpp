@@ -16,16 +16,20 @@ limitations under the License.
 #include "PointerAnalysis/Models/MemoryModel/FieldSensitive/FSMemModel.h"
 #include "PointerAnalysis/PointerAnalysisPass.h"
 #include "PointerAnalysis/Solver/PartialUpdateSolver.h"
+#include "PointerAnalysis/Solver/PointsTo/HashConsedPTS.h"
 #include "PreProcessing/Passes/CanonicalizeGEPPass.h"
 #include "PreProcessing/Passes/InsertGlobalCtorCallPass.h"
 #include "PreProcessing/Passes/LoweringMemCpyPass.h"
 #include "PreProcessing/Passes/RemoveExceptionHandlerPass.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Support/CommandLine.h"
 
 using namespace pta;
 
+extern llvm::cl::opt<bool> CONFIG_OFFLINE_REDUCTION;
+
 using Model = DefaultLangModel<NoCtx, FSMemModel<NoCtx>>;
 using Solver = PartialUpdateSolver<Model>;
 
@@ -128,3 +132,117 @@ TEST_CASE("PointerAnalysis", "[unit][PointerAnalysis]") {
     passes.run(*module);
   }
 }
+
+namespace {
+
+using HashConsedSolver = PartialUpdateSolver<DefaultLangModel<NoCtx, FSMemModel<NoCtx>, HashConsedPTS>>;
+
+// Allocation sites of the objects pointed to by every pointer in module, analyzed with numWorkers threads
+// Every level of the copy graph is propagated on all workers, however small, so the test inputs exercise them
+template <typename SolverTy = Solver>
+std::map<const llvm::Value *, std::multiset<const llvm::Value *>> getAllPointsTo(llvm::Module &module,
+                                                                                 unsigned int numWorkers) {
+  SolverTy::CT::release();
+  SolverTy solver;
+  solver.setNumWorkers(numWorkers);
+  solver.setMinParallelLevelSize(1);
+  solver.analyze(&module, "main");
+
+  std::map<const llvm::Value *, std::multiset<const llvm::Value *>> result;
+  auto const addPointsTo = [&](const llvm::Value *value) {
+    if (!value->getType()->isPointerTy()) return;
+    std::multiset<const typename SolverTy::ObjTy *> objects;
+    solver.getPointsTo(nullptr, value, objects);
+    auto &sites = result[value];
+    for (auto const obj : objects) {
+      sites.insert(obj->getValue());
+    }
+  };
+
+  for (auto const &func : module) {
+    for (auto const &arg : func.args()) {
+      addPointsTo(&arg);
+    }
+    for (auto const &inst : llvm::instructions(func)) {
+      addPointsTo(&inst);
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST_CASE("PointerAnalysis with parallel copy propagation", "[unit][PointerAnalysis]") {
+  const std::string prefix = "unit/PointerAnalysis/";
+  auto file = GENERATE("constraint-cycle-copy.ll", "constraint-cycle-field.ll", "constraint-cycle-pwc.ll",
+                       "funptr-struct.ll", "heap-linkedlist.ll", "spec-equake.ll", "spec-gap.ll", "spec-vortex.ll");
+
+  llvm::SMDiagnostic err;
+  llvm::LLVMContext context;
+  auto module = llvm::parseIRFile(prefix + file, err, context);
+  if (!module) {
+    err.print(file, llvm::errs());
+  }
+  REQUIRE(module != nullptr);
+
+  llvm::legacy::PassManager passes;
+  passes.add(new LegacyCanonicalizeGEPPass());
+  passes.add(new LoweringMemCpyLegacyPass());
+  passes.add(new RemoveExceptionHandlerLegacyPass());
+  passes.add(new InsertGlobalCtorCallPass());
+  passes.run(*module);
+
+  auto const sequential = getAllPointsTo(*module, 1);
+  CHECK(getAllPointsTo(*module, 4) == sequential);
+}
+
+TEST_CASE("PointerAnalysis with hash-consed points-to sets", "[unit][PointerAnalysis]") {
+  const std::string prefix = "unit/PointerAnalysis/";
+  auto file = GENERATE("constraint-cycle-copy.ll", "constraint-cycle-field.ll", "constraint-cycle-pwc.ll",
+                       "funptr-struct.ll", "heap-linkedlist.ll", "spec-equake.ll", "spec-gap.ll", "spec-vortex.ll");
+
+  llvm::SMDiagnostic err;
+  llvm::LLVMContext context;
+  auto module = llvm::parseIRFile(prefix + file, err, context);
+  if (!module) {
+    err.print(file, llvm::errs());
+  }
+  REQUIRE(module != nullptr);
+
+  llvm::legacy::PassManager passes;
+  passes.add(new LegacyCanonicalizeGEPPass());
+  passes.add(new LoweringMemCpyLegacyPass());
+  passes.add(new RemoveExceptionHandlerLegacyPass());
+  passes.add(new InsertGlobalCtorCallPass());
+  passes.run(*module);
+
+  auto const bitVector = getAllPointsTo(*module, 1);
+  CHECK(getAllPointsTo<HashConsedSolver>(*module, 1) == bitVector);
+  CHECK(getAllPointsTo<HashConsedSolver>(*module, 4) == bitVector);
+}
+
+TEST_CASE("PointerAnalysis with offline constraint graph reduction", "[unit][PointerAnalysis]") {
+  const std::string prefix = "unit/PointerAnalysis/";
+  auto file = GENERATE("branch-call.ll", "branch-intra.ll", "constraint-cycle-copy.ll", "constraint-cycle-pwc.ll",
+                       "funptr-struct.ll", "heap-linkedlist.ll", "spec-equake.ll", "spec-gap.ll", "spec-vortex.ll");
+
+  llvm::SMDiagnostic err;
+  llvm::LLVMContext context;
+  auto module = llvm::parseIRFile(prefix + file, err, context);
+  if (!module) {
+    err.print(file, llvm::errs());
+  }
+  REQUIRE(module != nullptr);
+
+  llvm::legacy::PassManager passes;
+  passes.add(new LegacyCanonicalizeGEPPass());
+  passes.add(new LoweringMemCpyLegacyPass());
+  passes.add(new RemoveExceptionHandlerLegacyPass());
+  passes.add(new InsertGlobalCtorCallPass());
+  passes.run(*module);
+
+  CONFIG_OFFLINE_REDUCTION = false;
+  auto const unreduced = getAllPointsTo(*module, 1);
+  CONFIG_OFFLINE_REDUCTION = true;
+  CHECK(getAllPointsTo(*module, 1) == unreduced);
+}
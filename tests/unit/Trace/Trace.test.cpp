@@ -106,6 +106,18 @@ declare i32 @pthread_join(i64, i8**)
     CHECK(join->type == race::Event::Type::Join);
   }
 
+  SECTION("Fork index") {
+    auto const &forks = threads.at(0)->getForkEvents();
+    REQUIRE(forks.size() == 1);
+    auto const fork = forks.front();
+    CHECK(program.getForkedThread(fork) == threads.at(1));
+
+    auto const handleForks = program.getForksWithHandle(fork->getIRInst()->getThreadHandle());
+    REQUIRE(handleForks.size() == 1);
+    CHECK(handleForks.front() == fork);
+    CHECK(threads.at(1)->getForkEvents().empty());
+  }
+
   SECTION("Spawned ThreadTrace") {
     auto const &thread = threads.at(1);
     auto const &events = thread->getEvents();
@@ -238,4 +250,424 @@ declare i32 @pthread_mutex_unlock(%union.pthread_mutex_t*) #1
 
   auto const &unlock = events.at(1);
   CHECK(unlock->type == race::Event::Type::Unlock);
-}
\ No newline at end of file
+}
+TEST_CASE("Build pthread ThreadTraces in parallel", "[unit][event]") {
+  const char *ModuleString = R"(
+%union.pthread_attr_t = type { i64, [48 x i8] }
+
+define i8* @leaf(i8* %c) {
+  %val = load i8, i8* %c
+  store i8 %val, i8* %c
+  ret i8* null
+}
+
+define i8* @spawner(i8* %c) {
+  %p_sub = alloca i64
+  %1 = call i32 @pthread_create(i64* %p_sub, %union.pthread_attr_t* null, i8* (i8*)* @leaf, i8* %c)
+  %sub = load i64, i64* %p_sub
+  %2 = call i32 @pthread_join(i64 %sub, i8** null)
+  ret i8* null
+}
+
+define void @foo(i8* %c) {
+  %p_t1 = alloca i64
+  %p_t2 = alloca i64
+  %p_t3 = alloca i64
+  %1 = call i32 @pthread_create(i64* %p_t1, %union.pthread_attr_t* null, i8* (i8*)* @spawner, i8* %c)
+  %2 = call i32 @pthread_create(i64* %p_t2, %union.pthread_attr_t* null, i8* (i8*)* @leaf, i8* %c)
+  %3 = call i32 @pthread_create(i64* %p_t3, %union.pthread_attr_t* null, i8* (i8*)* @spawner, i8* %c)
+  ret void
+}
+
+declare i32 @pthread_create(i64*, %union.pthread_attr_t*, i8* (i8*)*, i8*)
+declare i32 @pthread_join(i64, i8**)
+)";
+
+  auto const numWorkers = GENERATE(1u, 4u);
+
+  llvm::LLVMContext Ctx;
+  llvm::SMDiagnostic Err;
+  auto module = llvm::parseAssemblyString(ModuleString, Err, Ctx);
+  if (!module) {
+    Err.print("error", llvm::errs());
+  }
+
+  race::ProgramTrace program(module.get(), "foo", numWorkers);
+  auto const &threads = program.getThreads();
+  REQUIRE(threads.size() == 6);
+
+  // Threads are numbered depth first regardless of the order they were built in
+  for (size_t i = 0; i < threads.size(); ++i) {
+    CHECK(threads.at(i)->id == i);
+  }
+
+  auto const spawnerOf = [](const race::ThreadTrace *thread) { return thread->spawnSite.value()->getThread().id; };
+  CHECK(spawnerOf(threads.at(1)) == 0);
+  CHECK(spawnerOf(threads.at(2)) == 1);
+  CHECK(spawnerOf(threads.at(3)) == 0);
+  CHECK(spawnerOf(threads.at(4)) == 0);
+  CHECK(spawnerOf(threads.at(5)) == 4);
+
+  // spawner threads fork and join a leaf thread, leaf threads read and write
+  for (auto tid : {1, 4}) {
+    auto const &events = threads.at(tid)->getEvents();
+    REQUIRE(events.size() == 2);
+    CHECK(events.at(0)->type == race::Event::Type::Fork);
+    CHECK(events.at(1)->type == race::Event::Type::Join);
+  }
+  for (auto tid : {2, 3, 5}) {
+    auto const &events = threads.at(tid)->getEvents();
+    REQUIRE(events.size() == 2);
+    CHECK(events.at(0)->type == race::Event::Type::Read);
+    CHECK(events.at(1)->type == race::Event::Type::Write);
+  }
+}
+
+TEST_CASE("Interned points-to sets", "[unit][event]") {
+  const char *modString = R"(
+@global = global i64 0, align 8
+
+define void @adder(i64* %c) {
+    %val = load i64, i64* %c
+    %add = add nsw i64 %val, 42
+    store i64 %add, i64* %c
+    ret void
+}
+
+define void @foo() {
+    %x = alloca i64
+    call void @adder(i64* %x)
+    %pval = load i64, i64* %x
+    %gval = load i64, i64* @global
+    ret void
+}
+)";
+
+  llvm::LLVMContext Ctx;
+  llvm::SMDiagnostic Err;
+  auto module = llvm::parseAssemblyString(modString, Err, Ctx);
+
+  race::ProgramTrace program(module.get(), "foo");
+  auto const &threads = program.getThreads();
+  REQUIRE(threads.size() == 1);
+
+  auto const &events = threads.at(0)->getEvents();
+  REQUIRE(events.size() == 6);
+  auto const read = llvm::cast<race::ReadEvent>(events.at(1).get());
+  auto const write = llvm::cast<race::WriteEvent>(events.at(2).get());
+  auto const localRead = llvm::cast<race::ReadEvent>(events.at(4).get());
+  auto const globalRead = llvm::cast<race::ReadEvent>(events.at(5).get());
+
+  // %c in adder and %x in foo point to the same object, so they share one set
+  REQUIRE(read->getAccessedMemory().size() == 1);
+  CHECK(read->getPointsToSetID() == write->getPointsToSetID());
+  CHECK(read->getPointsToSetID() == localRead->getPointsToSetID());
+  CHECK(read->getPointsToSetID() != globalRead->getPointsToSetID());
+  CHECK(read->getPointsToSetID() != race::PointsToSetTable::EMPTY);
+
+  auto const &pointsToSets = program.getPointsToSets();
+  CHECK(pointsToSets.getObjects(read->getPointsToSetID()).equals(read->getAccessedMemory()));
+  CHECK(pointsToSets.sharesNonThreadLocal(read->getPointsToSetID(), write->getPointsToSetID()));
+  CHECK_FALSE(pointsToSets.sharesNonThreadLocal(read->getPointsToSetID(), globalRead->getPointsToSetID()));
+  CHECK_FALSE(pointsToSets.sharesNonThreadLocal(read->getPointsToSetID(), race::PointsToSetTable::EMPTY));
+}
+
+TEST_CASE("ThreadTrace budget", "[unit][event]") {
+  const char *modString = R"(
+define void @inner(i64* %p) {
+    store i64 1, i64* %p
+    ret void
+}
+
+define void @outer(i64* %p) {
+    call void @inner(i64* %p)
+    %val = load i64, i64* %p
+    ret void
+}
+
+define void @foo() {
+    %x = alloca i64
+    call void @outer(i64* %x)
+    store i64 2, i64* %x
+    ret void
+}
+)";
+
+  llvm::LLVMContext Ctx;
+  llvm::SMDiagnostic Err;
+  auto module = llvm::parseAssemblyString(modString, Err, Ctx);
+
+  SECTION("No budget") {
+    race::ProgramTrace program(module.get(), "foo");
+    REQUIRE(program.getThreads().size() == 1);
+    CHECK(program.getThreads().at(0)->getEvents().size() == 7);
+    CHECK_FALSE(program.isTruncated());
+  }
+
+  SECTION("Call depth") {
+    race::TraceBudget budget;
+    budget.maxCallDepth = 2;
+    race::ProgramTrace program(module.get(), "foo", 1, budget);
+    REQUIRE(program.getThreads().size() == 1);
+    auto const &thread = program.getThreads().at(0);
+
+    auto const &events = thread->getEvents();
+    REQUIRE(events.size() == 4);
+    CHECK(events.at(0)->type == race::Event::Type::Call);
+    CHECK(events.at(1)->type == race::Event::Type::Read);
+    CHECK(events.at(2)->type == race::Event::Type::CallEnd);
+    CHECK(events.at(3)->type == race::Event::Type::Write);
+
+    auto const &truncations = thread->getTruncations();
+    REQUIRE(truncations.size() == 1);
+    CHECK(truncations.front().reason == race::TraceTruncation::Reason::CallDepth);
+    CHECK(truncations.front().inst->getFunction()->getName() == "outer");
+    CHECK(program.isTruncated());
+  }
+
+  SECTION("Thread events") {
+    race::TraceBudget budget;
+    budget.maxThreadEvents = 3;
+    race::ProgramTrace program(module.get(), "foo", 1, budget);
+    REQUIRE(program.getThreads().size() == 1);
+    auto const &thread = program.getThreads().at(0);
+
+    // open calls are still closed once the budget runs out
+    auto const &events = thread->getEvents();
+    REQUIRE(events.size() == 5);
+    CHECK(events.at(2)->type == race::Event::Type::Write);
+    CHECK(events.at(3)->type == race::Event::Type::CallEnd);
+    CHECK(events.at(4)->type == race::Event::Type::CallEnd);
+
+    auto const &truncations = thread->getTruncations();
+    REQUIRE(truncations.size() == 1);
+    CHECK(truncations.front().reason == race::TraceTruncation::Reason::ThreadEvents);
+    CHECK(llvm::isa<llvm::LoadInst>(truncations.front().inst));
+    CHECK(program.isTruncated());
+  }
+}
+
+TEST_CASE("Isomorphic thread classes", "[unit][event]") {
+  const char *ModuleString = R"(
+%union.pthread_attr_t = type { i64, [48 x i8] }
+
+@global = global i64 0, align 8
+
+define i8* @worker(i8* %arg) {
+  %val = load i64, i64* @global
+  %add = add nsw i64 %val, 1
+  store i64 %add, i64* @global
+  ret i8* null
+}
+
+define i8* @reader(i8* %arg) {
+  %val = load i64, i64* @global
+  ret i8* null
+}
+
+define void @foo() {
+  %p_t1 = alloca i64
+  %p_t2 = alloca i64
+  %p_t3 = alloca i64
+  %1 = call i32 @pthread_create(i64* %p_t1, %union.pthread_attr_t* null, i8* (i8*)* @worker, i8* null)
+  %2 = call i32 @pthread_create(i64* %p_t2, %union.pthread_attr_t* null, i8* (i8*)* @worker, i8* null)
+  %3 = call i32 @pthread_create(i64* %p_t3, %union.pthread_attr_t* null, i8* (i8*)* @reader, i8* null)
+  ret void
+}
+
+declare i32 @pthread_create(i64*, %union.pthread_attr_t*, i8* (i8*)*, i8*)
+)";
+
+  llvm::LLVMContext Ctx;
+  llvm::SMDiagnostic Err;
+  auto module = llvm::parseAssemblyString(ModuleString, Err, Ctx);
+  if (!module) {
+    Err.print("error", llvm::errs());
+  }
+
+  race::ProgramTrace program(module.get(), "foo");
+  auto const &threads = program.getThreads();
+  REQUIRE(threads.size() == 4);
+  CHECK(program.numThreadClasses() == 3);
+
+  // both worker threads have the same events on the same object
+  auto const workerClass = program.getThreadClass(1);
+  CHECK(program.getThreadClass(2) == workerClass);
+  CHECK(program.getClassMultiplicity(workerClass) == 2);
+
+  CHECK(program.getThreadClass(0) != workerClass);
+  CHECK(program.getThreadClass(3) != workerClass);
+  CHECK(program.getThreadClass(3) != program.getThreadClass(0));
+  CHECK(program.getClassMultiplicity(program.getThreadClass(0)) == 1);
+  CHECK(program.getClassMultiplicity(program.getThreadClass(3)) == 1);
+}
+
+TEST_CASE("Record calls out of band", "[unit][event]") {
+  const char *modString = R"(
+declare void @print(i64)
+
+define void @adder(i64* %c) {
+    %val = load i64, i64* %c
+    %add = add nsw i64 %val, 42
+    store i64 %add, i64* %c
+    ret void
+}
+
+define void @foo() {
+    %x = alloca i64
+    call void @adder(i64* %x)
+    %pval = load i64, i64* %x
+    call void @print(i64 %pval)
+    ret void
+}
+)";
+
+  auto const elideCallEvents = GENERATE(false, true);
+
+  llvm::LLVMContext Ctx;
+  llvm::SMDiagnostic Err;
+  auto module = llvm::parseAssemblyString(modString, Err, Ctx);
+
+  race::ProgramTrace program(module.get(), "foo", 1, race::TraceBudget(), false, elideCallEvents);
+  auto const &threads = program.getThreads();
+  REQUIRE(threads.size() == 1);
+
+  auto const &thread = threads.at(0);
+  auto const &events = thread->getEvents();
+  auto const &calls = thread->getCalls();
+  REQUIRE(calls.size() == 1);
+  CHECK(calls.front().call->getCalledFunction()->getName() == "adder");
+
+  // the read and write in adder are inside the call, the read in foo is not
+  std::vector<race::Event::Type> types;
+  for (auto const &event : events) {
+    types.push_back(event->type);
+  }
+  race::EventID adderRead = 0;
+  if (elideCallEvents) {
+    CHECK(types == std::vector<race::Event::Type>{race::Event::Type::Read, race::Event::Type::Write,
+                                                   race::Event::Type::Read, race::Event::Type::ExternCall});
+  } else {
+    CHECK(types == std::vector<race::Event::Type>{race::Event::Type::Call, race::Event::Type::Read,
+                                                   race::Event::Type::Write, race::Event::Type::CallEnd,
+                                                   race::Event::Type::Read, race::Event::Type::ExternCall});
+    adderRead = 1;
+  }
+
+  CHECK(calls.front().begin == adderRead);
+  CHECK(calls.front().end == adderRead + 2);
+  CHECK(thread->getCallStack(adderRead) == std::vector<const race::CallIR *>{calls.front().call});
+  CHECK(thread->getCallStack(adderRead + 1).size() == 1);
+  CHECK(thread->getCallStack(events.size() - 2).empty());
+}
+
+TEST_CASE("Share the events of repeated calls", "[unit][event]") {
+  const char *modString = R"(
+define void @adder(i64* %c) {
+    %val = load i64, i64* %c
+    %add = add nsw i64 %val, 42
+    store i64 %add, i64* %c
+    ret void
+}
+
+define void @mid(i64* %c) {
+    call void @adder(i64* %c)
+    ret void
+}
+
+define void @foo() {
+    %x = alloca i64
+    call void @mid(i64* %x)
+    call void @mid(i64* %x)
+    ret void
+}
+)";
+
+  auto const elideCallEvents = GENERATE(false, true);
+
+  llvm::LLVMContext Ctx;
+  llvm::SMDiagnostic Err;
+  auto module = llvm::parseAssemblyString(modString, Err, Ctx);
+
+  race::ProgramTrace program(module.get(), "foo", 1, race::TraceBudget(), false, elideCallEvents, true);
+  auto const &threads = program.getThreads();
+  REQUIRE(threads.size() == 1);
+
+  // mid is called from two call sites and so traversed twice, but adder is called in the same context both times
+  auto const &thread = threads.at(0);
+  std::vector<race::Event::Type> types;
+  for (auto const &event : thread->getEvents()) {
+    types.push_back(event->type);
+  }
+
+  race::EventID adderRead = 0;
+  race::EventID sharedCall = 2;
+  if (elideCallEvents) {
+    CHECK(types == std::vector<race::Event::Type>{race::Event::Type::Read, race::Event::Type::Write,
+                                                   race::Event::Type::Call});
+  } else {
+    CHECK(types == std::vector<race::Event::Type>{
+                       race::Event::Type::Call, race::Event::Type::Call, race::Event::Type::Read,
+                       race::Event::Type::Write, race::Event::Type::CallEnd, race::Event::Type::CallEnd,
+                       race::Event::Type::Call, race::Event::Type::Call, race::Event::Type::CallEnd,
+                       race::Event::Type::CallEnd});
+    adderRead = 2;
+    sharedCall = 7;
+  }
+
+  auto const &refs = thread->getSegmentRefs();
+  REQUIRE(refs.size() == 1);
+  CHECK(refs.front().call->getCalledFunction()->getName() == "adder");
+  CHECK(refs.front().at == sharedCall);
+  CHECK(refs.front().begin == adderRead);
+  CHECK(refs.front().end == adderRead + 2);
+  CHECK(thread->getSegmentRefs(0, sharedCall).empty());
+  CHECK(thread->getSegmentRefs(sharedCall, sharedCall + 1).size() == 1);
+}
+
+TEST_CASE("Do not share calls that make sync events", "[unit][event]") {
+  const char *modString = R"(
+%union.pthread_mutex_t = type { %struct.__pthread_mutex_s }
+%struct.__pthread_mutex_s = type { i32, i32, i32, i32, i32, i16, i16, %struct.__pthread_internal_list }
+%struct.__pthread_internal_list = type { %struct.__pthread_internal_list*, %struct.__pthread_internal_list* }
+
+@mutex = global %union.pthread_mutex_t zeroinitializer
+
+define void @adder(i64* %c) {
+    %1 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* @mutex)
+    %val = load i64, i64* %c
+    %add = add nsw i64 %val, 42
+    store i64 %add, i64* %c
+    %2 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* @mutex)
+    ret void
+}
+
+define void @mid(i64* %c) {
+    call void @adder(i64* %c)
+    ret void
+}
+
+define void @foo() {
+    %x = alloca i64
+    call void @mid(i64* %x)
+    call void @mid(i64* %x)
+    ret void
+}
+
+declare i32 @pthread_mutex_lock(%union.pthread_mutex_t*)
+declare i32 @pthread_mutex_unlock(%union.pthread_mutex_t*)
+)";
+
+  llvm::LLVMContext Ctx;
+  llvm::SMDiagnostic Err;
+  auto module = llvm::parseAssemblyString(modString, Err, Ctx);
+
+  race::ProgramTrace program(module.get(), "foo", 1, race::TraceBudget(), false, true, true);
+  auto const &threads = program.getThreads();
+  REQUIRE(threads.size() == 1);
+
+  // adder holds a lock, so both calls are traversed
+  auto const &thread = threads.at(0);
+  CHECK(thread->getSegmentRefs().empty());
+  CHECK(thread->getEvents().size() == 8);
+}